@@ -45,6 +45,7 @@ b_tree_t *b_tree_create(size_t data_size)
 
 	b_tree->root = NULL;
 	b_tree->data_size = data_size;
+	b_tree->out = NULL;
 
 	return b_tree;
 }
@@ -249,17 +250,13 @@ void q_free(queue_t *q)
  * This function loads data from a file and creates a binary tree.
  *
  * @param tree - The binary tree to load the data into.
+ * @param filename - The name of the file with the points.
  * @param k - A pointer to the value representing the number of coordinates.
  *
  * @return b_tree_t* - A pointer to the loaded binary tree.
 *****************************************************************************/
-b_tree_t *load(b_tree_t *tree, int *k)
+b_tree_t *load(b_tree_t *tree, const char *filename, int *k)
 {
-	// Read the filename
-	char *filename = malloc(MAX_STRING_SIZE * sizeof(char));
-	DIE(!filename, "filename malloc failed!\n");
-	scanf("%s", filename);
-
 	// Open the file
 	FILE *file = fopen(filename, "r");
 	DIE(!file, "fopen malloc failed!\n");
@@ -283,7 +280,6 @@ b_tree_t *load(b_tree_t *tree, int *k)
 	}
 	// Close the file and free the memory
 	fclose(file);
-	free(filename);
 	return tree;
 }
 
@@ -391,8 +387,8 @@ void RS(b_tree_t *tree, b_node_t *node, int k, int *start, int *end)
 	// If the coordinates of the node are inside the range, print them
 	if (ok == 1) {
 		for (int i = 0; i < k; i++)
-			printf("%d ", vector_of_coord_node[i]);
-		printf("\n");
+			io_printf(tree->out, "%d ", vector_of_coord_node[i]);
+		io_write(tree->out, "\n", 1);
 	}
 }
 
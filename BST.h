@@ -8,11 +8,13 @@
 #include <stdio.h>
 #include <errno.h>
 #include <math.h>
+#include "io.h"
 
 #define MAX_NODES 150000
 #define MAX_STRING_SIZE 512
 #define INT_MAX 2147483647
 
+#ifndef DIE
 #define DIE(assertion, call_description)  \
 	do {                                  \
 										  \
@@ -24,6 +26,7 @@
 			exit(errno);                  \
 		}                                 \
 	} while (0)
+#endif
 
 typedef struct b_node_t b_node_t;
 struct b_node_t {
@@ -43,6 +46,9 @@ struct b_tree_t {
 
 	/* size of the data contained by the nodes */
 	size_t data_size;
+
+	/* buffer of the output, or NULL for stdout */
+	io_buffer_t *out;
 };
 
 typedef struct queue_t queue_t;
@@ -79,7 +85,7 @@ void b_tree_print_inorder(b_node_t *root);
 void __b_tree_free(b_node_t *b_node);
 void b_tree_free(b_tree_t *b_tree);
 
-b_tree_t *load(b_tree_t *tree, int *k);
+b_tree_t *load(b_tree_t *tree, const char *filename, int *k);
 void NN(b_tree_t *tree, b_node_t *root, int *vector_of_coord, int level,
 		int k, int *size, int *result, int *min_distance);
 void RS(b_tree_t *tree, b_node_t *root, int k, int *start, int *end);
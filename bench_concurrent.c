@@ -0,0 +1,286 @@
+/* <Copyright Niculici Mihai-Daniel 2023 > */
+
+// The read-write lock of the baseline has to let the writer in
+#define _GNU_SOURCE
+
+#include <pthread.h>
+#include <time.h>
+#include "trie.h"
+#include "concurrent.h"
+
+/* Reader thread counts measured by the benchmark, doubling up to this one */
+#define BENCH_MAX_READERS 8
+
+/* Most words of the files used to build the queries */
+#define BENCH_MAX_WORDS 65536
+
+/* One query out of BENCH_CORRECT_EVERY is an AUTOCORRECT, the rest are
+ * AUTOCOMPLETE of a prefix of up to BENCH_PREFIX_LEN letters */
+#define BENCH_CORRECT_EVERY 10
+#define BENCH_PREFIX_LEN 3
+
+/* The words of the queries, as they are stored in the trie */
+typedef struct bench_words_t bench_words_t;
+struct bench_words_t {
+	char (*word)[MAX_STRING_SIZE];
+	int n;
+};
+
+/* The shared state of a run */
+typedef struct bench_t bench_t;
+struct bench_t {
+	trie_t *trie;
+	bench_words_t *words;
+	int use_rwlock;
+	pthread_rwlock_t lock;
+	double writes_per_second;
+	int stop;
+};
+
+/* A reader thread and what it counted */
+typedef struct bench_reader_t bench_reader_t;
+struct bench_reader_t {
+	bench_t *bench;
+	u32 seed;
+	long queries;
+};
+
+/******************************************************************************
+ * This function returns the time of a monotonic clock, in seconds.
+ *
+ * @return seconds - The time.
+ *****************************************************************************/
+static double bench_now(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/******************************************************************************
+ * This function reads the words of a file, folded through the tokenizer
+ * table of the trie.
+ *
+ * @param trie - A pointer to the trie data structure.
+ * @param filename - The name of the file.
+ * @param words - The words read so far.
+ *****************************************************************************/
+static void bench_read_words(trie_t *trie, char *filename,
+							 bench_words_t *words)
+{
+	FILE *file = fopen(filename, "r");
+	DIE(!file, "Failed to open file");
+
+	int c, len = 0;
+
+	while (words->n < BENCH_MAX_WORDS) {
+		c = fgetc(file);
+		if (c != EOF && trie->fold[c] && len < MAX_STRING_SIZE - 1) {
+			words->word[words->n][len++] = trie->alphabet[trie->fold[c] - 1];
+			continue;
+		}
+		if (len > 0) {
+			words->word[words->n++][len] = '\0';
+			len = 0;
+		}
+		if (c == EOF)
+			break;
+	}
+
+	fclose(file);
+}
+
+/******************************************************************************
+ * This function returns the next number of a xorshift generator.
+ *
+ * @param seed - A pointer to the state of the generator.
+ *
+ * @return number - The number.
+ *****************************************************************************/
+static u32 bench_random(u32 *seed)
+{
+	*seed ^= *seed << 13;
+	*seed ^= *seed >> 17;
+	*seed ^= *seed << 5;
+	return *seed;
+}
+
+/******************************************************************************
+ * This function runs the queries of a reader thread until the run stops.
+ * The readers of the concurrent mode take the published version, the others
+ * hold the read lock of the trie during every query.
+ *
+ * @param arg - A pointer to the reader.
+ *
+ * @return NULL
+ *****************************************************************************/
+static void *bench_reader_run(void *arg)
+{
+	bench_reader_t *reader = arg;
+	bench_t *bench = reader->bench;
+	trie_reader_t *handle = NULL;
+	trie_t view;
+	io_buffer_t out;
+	char prefix[BENCH_PREFIX_LEN + 1];
+
+	io_buffer_init(&out, -1);
+	if (bench->use_rwlock) {
+		pthread_rwlock_rdlock(&bench->lock);
+		view = *bench->trie;
+		pthread_rwlock_unlock(&bench->lock);
+		view.out = &out;
+		view.symspell = NULL;
+	} else {
+		handle = concurrent_reader_create(bench->trie, &out);
+		DIE(!handle, "Too many readers");
+	}
+
+	while (!__atomic_load_n(&bench->stop, __ATOMIC_RELAXED)) {
+		u32 r = bench_random(&reader->seed);
+		char *word = bench->words->word[r % bench->words->n];
+		trie_t *trie = &view;
+
+		if (bench->use_rwlock) {
+			pthread_rwlock_rdlock(&bench->lock);
+			view.root = bench->trie->root;
+			view.nodes = bench->trie->nodes;
+			view.kids = bench->trie->kids;
+		} else {
+			trie = concurrent_reader_begin(handle);
+		}
+
+		if (r / 16 % BENCH_CORRECT_EVERY == 0) {
+			trie_autocorrect(trie, word, 1);
+		} else {
+			strncpy(prefix, word, BENCH_PREFIX_LEN);
+			prefix[BENCH_PREFIX_LEN] = '\0';
+			trie_autocomplete(trie, prefix, 0);
+		}
+
+		if (bench->use_rwlock)
+			pthread_rwlock_unlock(&bench->lock);
+		else
+			concurrent_reader_end(handle);
+
+		out.len = 0;
+		reader->queries++;
+	}
+
+	if (handle)
+		concurrent_reader_free(&handle);
+	io_buffer_free(&out);
+	return NULL;
+}
+
+/******************************************************************************
+ * This function measures one run: a writer that inserts and removes words
+ * at a steady rate, and a number of reader threads that query the trie.
+ *
+ * @param bench - A pointer to the shared state of the run.
+ * @param nreaders - The number of reader threads.
+ * @param seconds - The duration of the run.
+ *****************************************************************************/
+static void bench_run(bench_t *bench, int nreaders, double seconds)
+{
+	bench_reader_t readers[CONCURRENT_MAX_READERS];
+	pthread_t threads[CONCURRENT_MAX_READERS];
+	char word[MAX_STRING_SIZE + 2];
+	long writes = 0, queries = 0;
+
+	bench->stop = 0;
+	for (int i = 0; i < nreaders; i++) {
+		readers[i].bench = bench;
+		readers[i].seed = 2463534242u + i;
+		readers[i].queries = 0;
+		DIE(pthread_create(&threads[i], NULL, bench_reader_run, &readers[i]),
+			"Failed to start a reader");
+	}
+
+	// The writer adds a word and removes it again, so the trie keeps its
+	// size, and sleeps whenever it is ahead of the rate
+	double start = bench_now(), now = start;
+
+	while (now - start < seconds) {
+		if (writes >= (now - start) * bench->writes_per_second) {
+			struct timespec pause = {0, 100000};
+
+			nanosleep(&pause, NULL);
+			now = bench_now();
+			continue;
+		}
+
+		snprintf(word, sizeof(word), "%szz",
+				 bench->words->word[writes / 2 % bench->words->n]);
+		if (bench->use_rwlock)
+			pthread_rwlock_wrlock(&bench->lock);
+		if (writes % 2 == 0)
+			trie_insert(bench->trie, word);
+		else
+			trie_remove(bench->trie, word);
+		if (bench->use_rwlock)
+			pthread_rwlock_unlock(&bench->lock);
+		writes++;
+		now = bench_now();
+	}
+
+	__atomic_store_n(&bench->stop, 1, __ATOMIC_RELAXED);
+	for (int i = 0; i < nreaders; i++) {
+		pthread_join(threads[i], NULL);
+		queries += readers[i].queries;
+	}
+	now = bench_now();
+
+	printf("mode=%s readers=%d seconds=%.2f queries=%ld qps=%.0f "
+		   "writes=%ld wps=%.0f\n", bench->use_rwlock ? "rwlock" : "cow",
+		   nreaders, now - start, queries, queries / (now - start), writes,
+		   writes / (now - start));
+	fflush(stdout);
+}
+
+int main(int argc, char *argv[])
+{
+	bench_words_t words;
+	bench_t bench;
+
+	if (argc < 4) {
+		fprintf(stderr, "usage: %s <writes/s> <seconds> <file>...\n",
+				argv[0]);
+		return 1;
+	}
+
+	words.word = malloc(BENCH_MAX_WORDS * sizeof(*words.word));
+	DIE(!words.word, "Failed to allocate the words");
+	words.n = 0;
+
+	bench.trie = trie_create(ALPHABET_SIZE, ALPHABET);
+	for (int i = 3; i < argc; i++) {
+		trie_load(bench.trie, argv[i]);
+		bench_read_words(bench.trie, argv[i], &words);
+	}
+	DIE(words.n == 0, "No words in the files");
+	bench.words = &words;
+	bench.writes_per_second = atof(argv[1]);
+	pthread_rwlockattr_t attr;
+
+	pthread_rwlockattr_init(&attr);
+	pthread_rwlockattr_setkind_np(&attr,
+								  PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+	pthread_rwlock_init(&bench.lock, &attr);
+	pthread_rwlockattr_destroy(&attr);
+
+	// The same workload with a read-write lock, then lock-free
+	for (int mode = 1; mode >= 0; mode--) {
+		bench.use_rwlock = mode;
+		if (!mode)
+			DIE(concurrent_enable(bench.trie) < 0,
+				"Failed to enable the concurrent mode");
+		for (int readers = 1; readers <= BENCH_MAX_READERS; readers *= 2)
+			bench_run(&bench, readers, atof(argv[2]));
+	}
+
+	pthread_rwlock_destroy(&bench.lock);
+	trie_free(&bench.trie);
+	free(words.word);
+	return 0;
+}
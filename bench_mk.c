@@ -0,0 +1,386 @@
+/* <Copyright Niculici Mihai-Daniel 2023 > */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "trie.h"
+#include "cache.h"
+#include "command.h"
+
+/* Most kinds of commands a workload may use */
+#define BENCH_MAX_KINDS 32
+
+/* Longest name of a kind of command */
+#define BENCH_NAME_SIZE 32
+
+/* Prefix of the synthetic workloads, followed by their number of words */
+#define BENCH_ZIPF "zipf:"
+
+/*
+ * A synthetic workload draws its words from a vocabulary of one distinct
+ * word for every BENCH_VOCABULARY_RATIO words inserted, then runs one query
+ * for every BENCH_QUERY_RATIO of them
+ */
+#define BENCH_VOCABULARY_RATIO 10
+#define BENCH_QUERY_RATIO 10
+#define BENCH_MIN_VOCABULARY 1000
+
+/* Lengths of the synthetic words */
+#define BENCH_MIN_LEN 3
+#define BENCH_MAX_LEN 12
+
+/*
+ * Latencies of a kind of command, in nanoseconds. The kinds of AUTOCOMPLETE
+ * and AUTOCORRECT are told apart by their argument, like AUTOCOMPLETE_TOP
+ * or AUTOCORRECT_2.
+ */
+typedef struct bench_kind_t bench_kind_t;
+struct bench_kind_t {
+	char name[BENCH_NAME_SIZE];
+	u32 *ns;
+	size_t n;
+	size_t cap;
+};
+
+/* What a workload measured */
+typedef struct bench_result_t bench_result_t;
+struct bench_result_t {
+	bench_kind_t kinds[BENCH_MAX_KINDS];
+	int nkinds;
+	double seconds;
+	unsigned long output;
+};
+
+/******************************************************************************
+ * This function returns the time of a monotonic clock, in seconds.
+ *
+ * @return seconds - The time.
+ *****************************************************************************/
+static double bench_now(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/******************************************************************************
+ * This function returns the next number of a xorshift generator.
+ *
+ * @param seed - A pointer to the state of the generator.
+ *
+ * @return number - The number.
+ *****************************************************************************/
+static u32 bench_random(u32 *seed)
+{
+	*seed ^= *seed << 13;
+	*seed ^= *seed >> 17;
+	*seed ^= *seed << 5;
+	return *seed;
+}
+
+/******************************************************************************
+ * This function writes the name of the kind of a command: the command, and
+ * for AUTOCOMPLETE and AUTOCORRECT, the task, the tolerance, TOP or EDIT,
+ * followed by the distance of a FUZZY AUTOCOMPLETE.
+ *
+ * @param line - The line of the command, before it is split into tokens.
+ * @param name - The name, of BENCH_NAME_SIZE bytes.
+ *****************************************************************************/
+static void bench_kind_name(const char *line, char *name)
+{
+	char command[BENCH_NAME_SIZE / 2] = "", arg[BENCH_NAME_SIZE / 2] = "";
+	char fuzzy[8] = "", k[8] = "";
+	int fields;
+
+	// A blank line has no fields and keeps the empty name
+	fields = sscanf(line, "%15s %*s %15s %7s %7s", command, arg, fuzzy, k);
+	if (fields == 4 && strcmp(command, "AUTOCOMPLETE") == 0 &&
+		strcmp(fuzzy, "FUZZY") == 0)
+		snprintf(name, BENCH_NAME_SIZE, "%s_%s_FUZZY_%s", command, arg, k);
+	else if (fields >= 2 && (strcmp(command, "AUTOCOMPLETE") == 0 ||
+							 strcmp(command, "AUTOCORRECT") == 0))
+		snprintf(name, BENCH_NAME_SIZE, "%s_%s", command, arg);
+	else
+		snprintf(name, BENCH_NAME_SIZE, "%s", command);
+}
+
+/******************************************************************************
+ * This function adds the latency of a command to the ones of its kind.
+ *
+ * @param result - A pointer to what the workload measured.
+ * @param name - The name of the kind of the command.
+ * @param seconds - The time the command took.
+ *****************************************************************************/
+static void bench_record(bench_result_t *result, char *name, double seconds)
+{
+	bench_kind_t *kind = NULL;
+
+	for (int i = 0; i < result->nkinds && !kind; i++)
+		if (strcmp(result->kinds[i].name, name) == 0)
+			kind = &result->kinds[i];
+	if (!kind) {
+		DIE(result->nkinds == BENCH_MAX_KINDS, "Too many kinds of commands");
+		kind = &result->kinds[result->nkinds++];
+		*kind = (bench_kind_t){"", NULL, 0, 0};
+		strcpy(kind->name, name);
+	}
+
+	if (kind->n == kind->cap) {
+		kind->cap = kind->cap ? 2 * kind->cap : 1024;
+		kind->ns = realloc(kind->ns, kind->cap * sizeof(u32));
+		DIE(!kind->ns, "Failed to grow the latencies");
+	}
+	kind->ns[kind->n++] = seconds < 4.0 ? seconds * 1e9 : UINT32_MAX;
+}
+
+/******************************************************************************
+ * This function runs the commands of a file on a new trie, the way mk does,
+ * and measures every one of them. The results are counted, then dropped.
+ *
+ * @param fd - The file descriptor of the commands.
+ * @param result - A pointer to what the workload measured.
+ *****************************************************************************/
+static void bench_replay(int fd, bench_result_t *result)
+{
+	io_reader_t in;
+	io_buffer_t out;
+
+	io_reader_init(&in, fd);
+	io_buffer_init(&out, -1);
+
+	trie_t *trie = trie_create(ALPHABET_SIZE, ALPHABET);
+	trie->out = &out;
+	trie->cache = cache_create(CACHE_DEFAULT_ENTRIES);
+
+	double start = bench_now();
+	char *line, name[BENCH_NAME_SIZE];
+
+	while ((line = io_read_line(&in))) {
+		// The kind is named before the tokens are cut in place
+		bench_kind_name(line, name);
+
+		double before = bench_now();
+		int code = command_execute(trie, &in);
+		double after = bench_now();
+
+		if (code == COMMAND_NONE)
+			continue;
+		bench_record(result, name, after - before);
+		result->output += out.len;
+		out.len = 0;
+		if (code == EXIT)
+			break;
+	}
+	result->seconds = bench_now() - start;
+
+	trie_free(&trie);
+	io_buffer_free(&out);
+	io_reader_free(&in);
+}
+
+/******************************************************************************
+ * This function picks a word of the vocabulary, the word of rank i with a
+ * probability proportional to 1 / (i + 1) (Zipf's law).
+ *
+ * @param cdf - The sums of the weights of the first words.
+ * @param n - The number of words.
+ * @param seed - A pointer to the state of the generator.
+ *
+ * @return rank - The rank of the word.
+ *****************************************************************************/
+static int bench_zipf(double *cdf, int n, u32 *seed)
+{
+	double target = bench_random(seed) / 4294967296.0 * cdf[n - 1];
+	int low = 0, high = n - 1;
+
+	while (low < high) {
+		int middle = (low + high) / 2;
+
+		if (cdf[middle] < target)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+	return low;
+}
+
+/******************************************************************************
+ * This function writes a synthetic workload: INSERTs of words drawn from a
+ * Zipf distribution, then a mix of queries of the same distribution, with
+ * prefixes of 1 to 4 letters, every AUTOCOMPLETE task, TOP, AUTOCORRECT of
+ * words with a typo with a tolerance of 0 to 3 and by edit distance, and a
+ * few INSERTs and REMOVEs.
+ *
+ * @param file - The file of the workload.
+ * @param words - The number of words inserted.
+ *****************************************************************************/
+static void bench_generate(FILE *file, long words)
+{
+	// The letters by frequency: the first ones are drawn more often, so
+	// the words share prefixes like the words of a language do
+	static const char letters[] = "etaoinshrdlcumwfgypbvkjxqz";
+	u32 seed = 2463534242u;
+	int n = words / BENCH_VOCABULARY_RATIO;
+
+	if (n < BENCH_MIN_VOCABULARY)
+		n = BENCH_MIN_VOCABULARY;
+
+	char (*vocabulary)[BENCH_MAX_LEN + 1] = malloc(n * sizeof(*vocabulary));
+	double *cdf = malloc(n * sizeof(double));
+	DIE(!vocabulary || !cdf, "Failed to allocate the vocabulary");
+
+	for (int i = 0; i < n; i++) {
+		int len = BENCH_MIN_LEN + bench_random(&seed) %
+				  (BENCH_MAX_LEN - BENCH_MIN_LEN + 1);
+
+		for (int j = 0; j < len; j++) {
+			u32 r = bench_random(&seed);
+
+			vocabulary[i][j] = letters[r % 26 * (r / 26 % 26) / 25];
+		}
+		vocabulary[i][len] = '\0';
+		cdf[i] = (i ? cdf[i - 1] : 0) + 1.0 / (i + 1);
+	}
+
+	for (long i = 0; i < words; i++)
+		fprintf(file, "INSERT %s\n", vocabulary[bench_zipf(cdf, n, &seed)]);
+
+	for (long i = 0; i < words / BENCH_QUERY_RATIO; i++) {
+		char *word = vocabulary[bench_zipf(cdf, n, &seed)];
+		int len = strlen(word), pick = bench_random(&seed) % 20;
+		int prefix = 1 + i % 4 < len ? 1 + i % 4 : len;
+		char typo[BENCH_MAX_LEN + 1];
+
+		strcpy(typo, word);
+		typo[bench_random(&seed) % len] = letters[bench_random(&seed) % 26];
+
+		if (pick < 8)
+			fprintf(file, "AUTOCOMPLETE %.*s %ld\n", prefix, word, i / 4 % 4);
+		else if (pick < 10)
+			fprintf(file, "AUTOCOMPLETE %.*s TOP 5\n", prefix, word);
+		else if (pick < 16)
+			fprintf(file, "AUTOCORRECT %s %ld\n", typo, i % 4);
+		else if (pick < 17)
+			fprintf(file, "AUTOCORRECT %s EDIT 1\n", typo);
+		else if (pick < 19)
+			fprintf(file, "INSERT %s\n", word);
+		else
+			fprintf(file, "REMOVE %s\n", word);
+	}
+
+	free(vocabulary);
+	free(cdf);
+}
+
+/******************************************************************************
+ * This function compares two latencies, for qsort.
+ *
+ * @param a - A pointer to the first latency.
+ * @param b - A pointer to the second latency.
+ *
+ * @return order - Negative, 0 or positive, like strcmp.
+ *****************************************************************************/
+static int bench_compare(const void *a, const void *b)
+{
+	u32 x = *(const u32 *)a, y = *(const u32 *)b;
+
+	return (x > y) - (x < y);
+}
+
+/******************************************************************************
+ * This function compares the names of two kinds of commands, for qsort.
+ *
+ * @param a - A pointer to the first kind.
+ * @param b - A pointer to the second kind.
+ *
+ * @return order - Negative, 0 or positive, like strcmp.
+ *****************************************************************************/
+static int bench_compare_kinds(const void *a, const void *b)
+{
+	return strcmp(((const bench_kind_t *)a)->name,
+				  ((const bench_kind_t *)b)->name);
+}
+
+/******************************************************************************
+ * This function prints what a workload measured, one line for every kind of
+ * command and one for the whole workload, as "key=value" fields.
+ *
+ * @param label - The label of the run, like the commit it measures.
+ * @param name - The name of the workload.
+ * @param result - A pointer to what the workload measured.
+ *****************************************************************************/
+static void bench_report(char *label, char *name, bench_result_t *result)
+{
+	unsigned long commands = 0;
+
+	// In the order of the names, so the reports of two runs line up
+	qsort(result->kinds, result->nkinds, sizeof(bench_kind_t),
+		  bench_compare_kinds);
+	for (int i = 0; i < result->nkinds; i++) {
+		bench_kind_t *kind = &result->kinds[i];
+		double total = 0;
+
+		qsort(kind->ns, kind->n, sizeof(u32), bench_compare);
+		for (size_t j = 0; j < kind->n; j++)
+			total += kind->ns[j];
+		commands += kind->n;
+
+		printf("label=%s workload=%s command=%s count=%zu mean_ns=%.0f "
+			   "p50_ns=%u p90_ns=%u p99_ns=%u max_ns=%u\n", label, name,
+			   kind->name, kind->n, total / kind->n,
+			   kind->ns[kind->n / 2], kind->ns[kind->n * 9 / 10],
+			   kind->ns[kind->n * 99 / 100], kind->ns[kind->n - 1]);
+		free(kind->ns);
+	}
+
+	printf("label=%s workload=%s command=ALL count=%lu seconds=%.3f "
+		   "commands_per_second=%.0f output_bytes=%lu\n", label, name,
+		   commands, result->seconds, commands / result->seconds,
+		   result->output);
+	fflush(stdout);
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc < 3) {
+		fprintf(stderr, "usage: %s <label> <mk input | %s<words>>...\n",
+				argv[0], BENCH_ZIPF);
+		return 1;
+	}
+
+	for (int i = 2; i < argc; i++) {
+		bench_result_t result = {.nkinds = 0, .output = 0};
+		char *name = argv[i];
+		int fd;
+
+		if (strncmp(name, BENCH_ZIPF, strlen(BENCH_ZIPF)) == 0) {
+			// The workload is written to a temporary file first, so
+			// generating it is not measured
+			FILE *file = tmpfile();
+			DIE(!file, "Failed to create the workload");
+
+			bench_generate(file, atol(name + strlen(BENCH_ZIPF)));
+			DIE(fflush(file) != 0, "Failed to write the workload");
+			fd = dup(fileno(file));
+			fclose(file);
+			DIE(fd < 0 || lseek(fd, 0, SEEK_SET) < 0,
+				"Failed to rewind the workload");
+		} else {
+			fd = open(name, O_RDONLY);
+			DIE(fd < 0, "Failed to open the workload");
+		}
+
+		// The name of a file, without its directories
+		if (strrchr(name, '/'))
+			name = strrchr(name, '/') + 1;
+
+		bench_replay(fd, &result);
+		close(fd);
+		bench_report(argv[1], name, &result);
+	}
+
+	return 0;
+}
@@ -0,0 +1,463 @@
+/* <Copyright Niculici Mihai-Daniel 2023 > */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <time.h>
+#include "cache.h"
+
+/* Names of the kinds of queries, as they are reported */
+static const char *cache_kind_names[CACHE_KINDS] = {
+	"AUTOCOMPLETE TOP", "AUTOCORRECT", "AUTOCORRECT EDIT"
+};
+
+/******************************************************************************
+ * This function returns the time of a monotonic clock, in seconds.
+ *
+ * @return seconds - The time.
+ *****************************************************************************/
+static double cache_now(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/******************************************************************************
+ * This function creates a cache of query results.
+ *
+ * @param cap - The number of results it keeps, at least 1.
+ *
+ * @return cache - A pointer to the cache created.
+ *****************************************************************************/
+cache_t *cache_create(int cap)
+{
+	cache_t *cache = calloc(1, sizeof(cache_t));
+	DIE(!cache, "Failed to allocate the cache");
+
+	cache->cap = cap;
+	cache->entries = malloc(cap * sizeof(cache_entry_t));
+	DIE(!cache->entries, "Failed to allocate the cache entries");
+
+	// Two buckets for every entry keep the chains short
+	cache->nbuckets = 1;
+	while (cache->nbuckets < 2 * (u32)cap)
+		cache->nbuckets *= 2;
+	cache->buckets = malloc(cache->nbuckets * sizeof(int));
+	DIE(!cache->buckets, "Failed to allocate the cache buckets");
+
+	io_buffer_init(&cache->scratch, -1);
+	cache_clear(cache);
+
+	return cache;
+}
+
+/******************************************************************************
+ * This function drops every result of the cache, when the nodes of the trie
+ * are replaced at once (FREEZE, OPEN, LOADFREQ...) and the generations of
+ * the nodes no longer mean anything. The statistics are kept.
+ *
+ * @param cache - A pointer to the cache.
+ *****************************************************************************/
+void cache_clear(cache_t *cache)
+{
+	for (int i = 0; i < cache->used; i++)
+		free(cache->entries[i].data);
+	cache->used = 0;
+
+	for (u32 i = 0; i < cache->nbuckets; i++)
+		cache->buckets[i] = CACHE_NONE;
+	cache->newest = CACHE_NONE;
+	cache->oldest = CACHE_NONE;
+
+	cache->generation = 0;
+	if (cache->node_gens)
+		memset(cache->node_gens, 0,
+			   cache->node_gens_cap * sizeof(u32));
+	memset(cache->length_gens, 0, sizeof(cache->length_gens));
+
+	// The query in progress keeps its output, but not its old entry
+	cache->pending_entry = CACHE_NONE;
+}
+
+/******************************************************************************
+ * This function frees a cache.
+ *
+ * @param pcache - A double pointer to the cache.
+ *****************************************************************************/
+void cache_free(cache_t **pcache)
+{
+	cache_t *cache = *pcache;
+
+	for (int i = 0; i < cache->used; i++)
+		free(cache->entries[i].data);
+	free(cache->entries);
+	free(cache->buckets);
+	free(cache->node_gens);
+	io_buffer_free(&cache->scratch);
+	free(cache);
+	*pcache = NULL;
+}
+
+/******************************************************************************
+ * This function starts the generation of a change of the trie: the INSERT or
+ * the REMOVE of a word. The nodes of its path are then stamped with
+ * cache_touch.
+ *
+ * @param cache - A pointer to the cache.
+ * @param len - The length of the word, if the words of that length changed,
+ *              or -1 if only the frequency of the word did.
+ *****************************************************************************/
+void cache_change(cache_t *cache, int len)
+{
+	// After so many changes the generations start over, with no entries
+	if (cache->generation == UINT32_MAX)
+		cache_clear(cache);
+
+	cache->generation++;
+	if (len >= 0)
+		cache->length_gens[len] = cache->generation;
+}
+
+/******************************************************************************
+ * This function stamps a node with the generation of the current change.
+ *
+ * @param cache - A pointer to the cache.
+ * @param node - The index of the node.
+ *****************************************************************************/
+void cache_touch(cache_t *cache, u32 node)
+{
+	if (node >= cache->node_gens_cap) {
+		u32 cap = cache->node_gens_cap ? cache->node_gens_cap : 1024;
+
+		while (cap <= node)
+			cap *= 2;
+		cache->node_gens = realloc(cache->node_gens, cap * sizeof(u32));
+		DIE(!cache->node_gens, "Failed to grow the node generations");
+		memset(cache->node_gens + cache->node_gens_cap, 0,
+			   (cap - cache->node_gens_cap) * sizeof(u32));
+		cache->node_gens_cap = cap;
+	}
+
+	cache->node_gens[node] = cache->generation;
+}
+
+/******************************************************************************
+ * This function hashes the key of a query.
+ *
+ * @param kind - The kind of the query.
+ * @param word - The word of the query.
+ * @param arg - The task, tolerance or count of the query.
+ *
+ * @return hash - The hash of the key.
+ *****************************************************************************/
+static u32 cache_hash(int kind, const char *word, int arg)
+{
+	u32 hash = 2166136261u ^ ((u32)kind * 2654435761u) ^
+					((u32)arg * 2246822519u);
+
+	for (; *word; word++)
+		hash = (hash ^ (u8)*word) * 16777619u;
+
+	return hash;
+}
+
+/******************************************************************************
+ * This function returns the deepest node of the trie on the path of a
+ * prefix: every word that starts with the prefix is below it, so it is
+ * stamped by every change of their results.
+ *
+ * @param trie - A pointer to the trie data structure.
+ * @param prefix - The prefix.
+ *
+ * @return node - The index of the node, TRIE_NIL if the prefix has a
+ *                character outside of the alphabet and no word has it.
+ *****************************************************************************/
+static u32 cache_prefix_node(trie_t *trie, const char *prefix)
+{
+	u32 node = trie->root;
+
+	for (; *prefix; prefix++) {
+		int letter = trie->fold[(unsigned char)*prefix] - 1;
+
+		if (letter < 0)
+			return TRIE_NIL;
+
+		u32 next = trie_child(trie, node, letter);
+
+		if (next == TRIE_NIL)
+			break;
+		node = next;
+	}
+
+	return node;
+}
+
+/******************************************************************************
+ * This function checks if the result of an entry is still the one of its
+ * query: nothing it depends on changed since it was computed.
+ *
+ * @param cache - A pointer to the cache.
+ * @param entry - A pointer to the entry.
+ *
+ * @return valid - 1 if the result is valid, 0 otherwise.
+ *****************************************************************************/
+static int cache_valid(cache_t *cache, cache_entry_t *entry)
+{
+	if (entry->node < cache->node_gens_cap &&
+		cache->node_gens[entry->node] > entry->generation)
+		return 0;
+
+	for (int len = entry->min_len; len <= entry->max_len; len++)
+		if (cache->length_gens[len] > entry->generation)
+			return 0;
+
+	return 1;
+}
+
+/******************************************************************************
+ * This function takes an entry out of the LRU list.
+ *
+ * @param cache - A pointer to the cache.
+ * @param index - The index of the entry.
+ *****************************************************************************/
+static void cache_unlink(cache_t *cache, int index)
+{
+	cache_entry_t *entry = &cache->entries[index];
+
+	if (entry->newer != CACHE_NONE)
+		cache->entries[entry->newer].older = entry->older;
+	else
+		cache->newest = entry->older;
+	if (entry->older != CACHE_NONE)
+		cache->entries[entry->older].newer = entry->newer;
+	else
+		cache->oldest = entry->newer;
+}
+
+/******************************************************************************
+ * This function puts an entry at the front of the LRU list.
+ *
+ * @param cache - A pointer to the cache.
+ * @param index - The index of the entry.
+ *****************************************************************************/
+static void cache_push_newest(cache_t *cache, int index)
+{
+	cache_entry_t *entry = &cache->entries[index];
+
+	entry->newer = CACHE_NONE;
+	entry->older = cache->newest;
+	if (cache->newest != CACHE_NONE)
+		cache->entries[cache->newest].newer = index;
+	else
+		cache->oldest = index;
+	cache->newest = index;
+}
+
+/******************************************************************************
+ * This function takes the least recently used entry out of the cache, to
+ * reuse its slot.
+ *
+ * @param cache - A pointer to the cache.
+ *
+ * @return index - The index of the slot.
+ *****************************************************************************/
+static int cache_evict(cache_t *cache)
+{
+	int index = cache->oldest;
+	cache_entry_t *entry = &cache->entries[index];
+	int *link = &cache->buckets[entry->hash & (cache->nbuckets - 1)];
+
+	while (*link != index)
+		link = &cache->entries[*link].next;
+	*link = entry->next;
+
+	cache_unlink(cache, index);
+	free(entry->data);
+	cache->evictions++;
+
+	return index;
+}
+
+/******************************************************************************
+ * This function starts a query that the cache may answer. If its result is
+ * kept and valid, it is written to the output of the trie. Otherwise the
+ * output of the query goes to the cache until cache_end, which keeps it.
+ * Nothing is cached in the concurrent mode, whose readers have their own
+ * views of the trie.
+ *
+ * @param trie - A pointer to the trie data structure.
+ * @param kind - The kind of the query.
+ * @param word - The word of the query.
+ * @param arg - The task, tolerance or count of the query.
+ *
+ * @return answered - 1 if the result was written, 0 if the query has to be
+ *                    computed.
+ *****************************************************************************/
+int cache_begin(trie_t *trie, int kind, const char *word, int arg)
+{
+	cache_t *cache = trie->cache;
+
+	if (!cache || trie->concurrent)
+		return 0;
+
+	// A query that another query runs is not kept on its own
+	if (cache->pending) {
+		cache->pending++;
+		return 0;
+	}
+
+	double start = cache_now();
+	u32 hash = cache_hash(kind, word, arg);
+	int index = cache->buckets[hash & (cache->nbuckets - 1)];
+	int key_len = strlen(word);
+
+	while (index != CACHE_NONE) {
+		cache_entry_t *entry = &cache->entries[index];
+
+		if (entry->hash == hash && entry->kind == kind &&
+			entry->arg == arg && entry->key_len == key_len &&
+			memcmp(entry->data, word, key_len) == 0)
+			break;
+		index = entry->next;
+	}
+
+	if (index != CACHE_NONE && cache_valid(cache, &cache->entries[index])) {
+		cache_entry_t *entry = &cache->entries[index];
+
+		io_write(trie->out, entry->data + key_len, entry->len);
+		cache_unlink(cache, index);
+		cache_push_newest(cache, index);
+		cache->stats[kind].hits++;
+		cache->stats[kind].hit_seconds += cache_now() - start;
+		return 1;
+	}
+
+	// The result is computed into the scratch buffer
+	if (index != CACHE_NONE)
+		cache->stats[kind].stale++;
+	cache->pending = 1;
+	cache->pending_kind = kind;
+	cache->pending_arg = arg;
+	cache->pending_entry = index;
+	cache->pending_hash = hash;
+	cache->pending_word = word;
+	cache->pending_start = start;
+	cache->out = trie->out;
+	cache->scratch.len = 0;
+	trie->out = &cache->scratch;
+
+	return 0;
+}
+
+/******************************************************************************
+ * This function ends a query started with cache_begin: its output is written
+ * to the output of the trie and kept, with what it depends on, in place of
+ * the out of date entry of the query or of the least recently used one.
+ *
+ * @param trie - A pointer to the trie data structure.
+ *****************************************************************************/
+void cache_end(trie_t *trie)
+{
+	cache_t *cache = trie->cache;
+
+	if (!cache || trie->concurrent || cache->pending == 0)
+		return;
+	if (cache->pending > 1) {
+		cache->pending--;
+		return;
+	}
+
+	const char *word = cache->pending_word;
+	int kind = cache->pending_kind, key_len = strlen(word);
+	size_t len = cache->scratch.len;
+
+	cache->pending = 0;
+	trie->out = cache->out;
+	io_write(trie->out, cache->scratch.data, len);
+
+	int index = cache->pending_entry;
+
+	if (len <= CACHE_MAX_RESULT) {
+		if (index != CACHE_NONE) {
+			cache_unlink(cache, index);
+			free(cache->entries[index].data);
+		} else {
+			index = cache->used < cache->cap ? cache->used++
+											 : cache_evict(cache);
+			cache->entries[index].next =
+				cache->buckets[cache->pending_hash & (cache->nbuckets - 1)];
+			cache->buckets[cache->pending_hash & (cache->nbuckets - 1)] =
+				index;
+		}
+
+		cache_entry_t *entry = &cache->entries[index];
+
+		entry->hash = cache->pending_hash;
+		entry->kind = kind;
+		entry->arg = cache->pending_arg;
+		entry->data = malloc(key_len + len);
+		DIE(!entry->data, "Failed to allocate a cache entry");
+		memcpy(entry->data, word, key_len);
+		memcpy(entry->data + key_len, cache->scratch.data, len);
+		STATS_ADD(trie, bytes, key_len + len);
+		entry->key_len = key_len;
+		entry->len = len;
+		entry->generation = cache->generation;
+
+		// A TOP depends on the subtree of its prefix, a Hamming AUTOCORRECT
+		// on the words of its length and an edit distance of k on the
+		// lengths within k of it
+		entry->node = TRIE_NIL;
+		entry->min_len = 1;
+		entry->max_len = 0;
+		if (kind == CACHE_TOP) {
+			entry->node = cache_prefix_node(trie, word);
+		} else {
+			int k = kind == CACHE_EDIT ? entry->arg : 0;
+
+			if (k >= 0) {
+				entry->min_len = key_len - k > 0 ? key_len - k : 0;
+				entry->max_len = key_len + k < MAX_STRING_SIZE - 1 ?
+								 key_len + k : MAX_STRING_SIZE - 1;
+			}
+		}
+		cache_push_newest(cache, index);
+	}
+
+	cache->stats[kind].misses++;
+	cache->stats[kind].miss_seconds += cache_now() - cache->pending_start;
+}
+
+/******************************************************************************
+ * This function prints the statistics of the cache: its size, then the hit
+ * rate and the mean time of a hit and of a miss for every kind of query.
+ *
+ * @param cache - A pointer to the cache, or NULL if it is disabled.
+ * @param out - The buffer of the output, or NULL for stdout.
+ *****************************************************************************/
+void cache_report(cache_t *cache, io_buffer_t *out)
+{
+	if (!cache) {
+		io_printf(out, "cache disabled\n");
+		return;
+	}
+
+	io_printf(out, "cache entries: %d/%d, evictions: %lu\n", cache->used,
+			  cache->cap, cache->evictions);
+
+	for (int kind = 0; kind < CACHE_KINDS; kind++) {
+		cache_stats_t *stats = &cache->stats[kind];
+		unsigned long queries = stats->hits + stats->misses;
+
+		if (queries == 0)
+			continue;
+		io_printf(out, "%s queries: %lu, hits: %lu (%.1f%%), stale: %lu, "
+				  "hit: %.2f us, miss: %.2f us\n", cache_kind_names[kind],
+				  queries, stats->hits, 100.0 * stats->hits / queries,
+				  stats->stale,
+				  stats->hits ? stats->hit_seconds * 1e6 / stats->hits : 0.0,
+				  stats->misses ?
+				  stats->miss_seconds * 1e6 / stats->misses : 0.0);
+	}
+}
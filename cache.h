@@ -0,0 +1,121 @@
+/* <Copyright Niculici Mihai-Daniel 2023 > */
+
+#ifndef CACHE_H_
+#define CACHE_H_
+
+#include "trie.h"
+
+/* Number of results kept by the cache of mk, SET cache <n> changes it */
+#define CACHE_DEFAULT_ENTRIES 4096
+
+/* Longest result kept, in bytes: the longer ones are computed every time */
+#define CACHE_MAX_RESULT 16384
+
+/*
+ * Kinds of queries whose results are kept, each with its own statistics.
+ * The tasks of AUTOCOMPLETE are not: the summaries of the nodes answer them
+ * in about the time of a lookup in the cache.
+ */
+#define CACHE_TOP 0
+#define CACHE_AUTOCORRECT 1
+#define CACHE_EDIT 2
+#define CACHE_KINDS 3
+
+/* Value of the links of an entry that is at the end of a list */
+#define CACHE_NONE -1
+
+/*
+ * Result of a query, with what it depends on. An AUTOCOMPLETE TOP only
+ * depends on the words below the deepest node of its prefix, an AUTOCORRECT
+ * on the words of the lengths it can match. The entry is valid while that
+ * node, or those lengths, have not changed since its generation.
+ */
+typedef struct cache_entry_t cache_entry_t;
+struct cache_entry_t {
+	u32 hash;
+	int kind;
+	int arg;
+
+	/* The word of the query, followed by the result */
+	char *data;
+	int key_len;
+	size_t len;
+
+	/* What the result depends on, and the generation it was computed in */
+	u32 node;
+	int min_len;
+	int max_len;
+	u32 generation;
+
+	/* Next entry of the same bucket, and the neighbours in the LRU list */
+	int next;
+	int newer;
+	int older;
+};
+
+/* Statistics of a kind of query */
+typedef struct cache_stats_t cache_stats_t;
+struct cache_stats_t {
+	unsigned long hits;
+	unsigned long misses;
+
+	/* Misses of an entry that was there, but out of date */
+	unsigned long stale;
+	double hit_seconds;
+	double miss_seconds;
+};
+
+/*
+ * Bounded cache of query results, evicted in LRU order. Every INSERT or
+ * REMOVE of a word starts a new generation and stamps it on the nodes of the
+ * path of the word and on its length, so an entry knows if anything it
+ * depends on changed after it was computed.
+ */
+typedef struct cache_t cache_t;
+struct cache_t {
+	cache_entry_t *entries;
+	int cap;
+	int used;
+
+	/* Hash table of the entries, chained through next */
+	int *buckets;
+	u32 nbuckets;
+
+	/* The most and the least recently used entries */
+	int newest;
+	int oldest;
+
+	/* Current generation, and the last one of every node and length */
+	u32 generation;
+	u32 *node_gens;
+	u32 node_gens_cap;
+	u32 length_gens[MAX_STRING_SIZE];
+
+	/*
+	 * Query being computed: its output goes to the scratch buffer, to be
+	 * kept once it is complete (see cache_end).
+	 */
+	int pending;
+	int pending_kind;
+	int pending_arg;
+	int pending_entry;
+	u32 pending_hash;
+	const char *pending_word;
+	double pending_start;
+	io_buffer_t *out;
+	io_buffer_t scratch;
+
+	cache_stats_t stats[CACHE_KINDS];
+	unsigned long evictions;
+};
+
+cache_t *cache_create(int cap);
+void cache_clear(cache_t *cache);
+void cache_free(cache_t **pcache);
+void cache_change(cache_t *cache, int len);
+void cache_touch(cache_t *cache, u32 node);
+int cache_begin(trie_t *trie, int kind, const char *word, int arg);
+void cache_end(trie_t *trie);
+void cache_report(cache_t *cache, io_buffer_t *out);
+
+#endif /* CACHE_H_ */
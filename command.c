@@ -0,0 +1,297 @@
+/* <Copyright Niculici Mihai-Daniel 2023 > */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <ctype.h>
+#include "command.h"
+#include "dawg.h"
+#include "snapshot.h"
+#include "cache.h"
+
+/******************************************************************************
+ * This function converts a number read from the input.
+ *
+ * @param token - The token of the number, or NULL if it is missing.
+ *
+ * @return number - The number, 0 if the token is missing.
+ *****************************************************************************/
+static int command_number(char *token)
+{
+	return token ? atoi(token) : 0;
+}
+
+/******************************************************************************
+ * This function checks whether a line belongs to a BATCH: it is either empty
+ * or a "<prefix> <task>" query, with a task of digits only and a prefix that
+ * is not the name of a command ("INSERT 42" is a command, since the alphabet
+ * may have digits). The line is not changed, so another one can still be run
+ * as a command.
+ *
+ * @param line - The line.
+ *
+ * @return answer - 1 if the line belongs to the batch, 0 otherwise.
+ *****************************************************************************/
+static int command_batch_line(const char *line)
+{
+	char name[COMMAND_NAME_SIZE] = "";
+	int tokens = 0, digits = 0;
+
+	while (*line) {
+		if (isspace((unsigned char)*line)) {
+			line++;
+			continue;
+		}
+
+		// The last token decides whether the task is a number
+		const char *token = line;
+
+		tokens++;
+		digits = 1;
+		for (; *line && !isspace((unsigned char)*line); line++)
+			if (!isdigit((unsigned char)*line))
+				digits = 0;
+
+		// The first one is copied, if it is short enough to be a command
+		if (tokens == 1 && line - token < COMMAND_NAME_SIZE) {
+			memcpy(name, token, line - token);
+			name[line - token] = '\0';
+		}
+	}
+
+	if (tokens == 0)
+		return 1;
+	// The code of EXIT is the -1 of the names that are not commands
+	return tokens == 2 && digits && which_command(name) == -1 &&
+		   strcmp(name, "EXIT") != 0;
+}
+
+/******************************************************************************
+ * This function reads the queries of a BATCH, one "<prefix> <task>" on every
+ * line, and answers them together (see trie_autocomplete_batch). The empty
+ * lines are skipped. The batch ends early at a line that is not a query, and
+ * that line is run as the next command, so EXIT is never taken for a query.
+ *
+ * @param in - The reader of the commands.
+ * @param trie - A pointer to the trie data structure.
+ * @param count - The number of lines of the batch, at most
+ *                COMMAND_BATCH_MAX are read.
+ *****************************************************************************/
+static void command_batch(io_reader_t *in, trie_t *trie, int count)
+{
+	char **prefixes = NULL;
+	int *tasks = NULL;
+	int n = 0, cap = 0;
+
+	if (count > COMMAND_BATCH_MAX)
+		count = COMMAND_BATCH_MAX;
+
+	// The tokens only live until the next line, so the prefixes are copied
+	for (int i = 0; i < count && io_read_line(in); i++) {
+		if (!command_batch_line(in->cursor)) {
+			io_unread_line(in);
+			break;
+		}
+
+		char *prefix = io_next_token(in);
+		char *task = io_next_token(in);
+
+		if (!prefix || !task)
+			continue;
+		if (n == cap) {
+			cap = cap ? 2 * cap : 64;
+			prefixes = realloc(prefixes, cap * sizeof(char *));
+			tasks = realloc(tasks, cap * sizeof(int));
+			DIE(!prefixes || !tasks, "Failed to grow the batch");
+		}
+		prefixes[n] = strdup(prefix);
+		DIE(!prefixes[n], "Failed to copy a prefix of the batch");
+		tasks[n++] = atoi(task);
+	}
+
+	trie_autocomplete_batch(trie, prefixes, tasks, n);
+
+	for (int i = 0; i < n; i++)
+		free(prefixes[i]);
+	free(prefixes);
+	free(tasks);
+}
+
+/******************************************************************************
+ * This function runs the commands that change the trie, or move it to and
+ * from a file.
+ *
+ * @param trie - A pointer to the trie data structure.
+ * @param code - The code of the command (see which_command).
+ * @param word - The word or the file name, NULL if it is missing.
+ *****************************************************************************/
+static void command_change(trie_t *trie, int code, char *word)
+{
+	switch (code) {
+	case INSERT:
+		// Insert the word
+		if (word)
+			trie_insert(trie, word);
+		break;
+
+	case REMOVE:
+		// Remove the word from the trie
+		if (word)
+			trie_remove(trie, word);
+		break;
+
+	case LOAD:
+		// Load the words from the file into the trie
+		if (word)
+			trie_load(trie, word);
+		break;
+
+	case LOADFREQ:
+		// Load a sorted list of words with their frequencies
+		if (word)
+			trie_load_freq(trie, word);
+		break;
+
+	case COMPACT:
+		// Reclaim the nodes that REMOVE left without words
+		trie_compact(trie);
+		break;
+
+	case FREEZE:
+		// Minimize the trie into a DAWG, until it is changed again
+		dawg_freeze(trie);
+		break;
+
+	case SAVE:
+		// Write the trie to a snapshot file
+		if (word)
+			snapshot_save(trie, word);
+		break;
+
+	case OPEN:
+		// Replace the trie with the one of a snapshot file
+		if (word)
+			snapshot_open(trie, word);
+		break;
+	}
+}
+
+/******************************************************************************
+ * This function runs an AUTOCOMPLETE, with a task, "<task> FUZZY <k>",
+ * "TOP <n>" or "PAGE <offset> <limit>". The numbers after the argument are
+ * read from the line.
+ *
+ * @param trie - A pointer to the trie data structure.
+ * @param in - The reader of the commands.
+ * @param word - The prefix.
+ * @param arg - The task, TOP or PAGE.
+ *****************************************************************************/
+static void command_autocomplete(trie_t *trie, io_reader_t *in, char *word,
+								 char *arg)
+{
+	if (strcmp(arg, "TOP") == 0) {
+		trie_autocomplete_top(trie, word, command_number(io_next_token(in)));
+	} else if (strcmp(arg, "PAGE") == 0) {
+		int offset = command_number(io_next_token(in));
+
+		trie_autocomplete_page(trie, word, offset,
+							   command_number(io_next_token(in)));
+	} else {
+		char *fuzzy = io_next_token(in);
+
+		if (fuzzy && strcmp(fuzzy, "FUZZY") == 0)
+			trie_autocomplete_fuzzy(trie, word, atoi(arg),
+									command_number(io_next_token(in)));
+		else
+			trie_autocomplete(trie, word, atoi(arg));
+	}
+}
+
+/******************************************************************************
+ * This function runs the command of the line the reader has just read, and
+ * writes its results to the output of the trie. It is the loop body of mk,
+ * shared with its benchmark.
+ *
+ * @param trie - A pointer to the trie data structure.
+ * @param in - The reader of the commands, after io_read_line.
+ *
+ * @return code - The code of the command (see which_command), COMMAND_NONE
+ * if the line is empty. The caller stops at EXIT.
+ *****************************************************************************/
+int command_execute(trie_t *trie, io_reader_t *in)
+{
+	char *command = io_next_token(in);
+
+	if (!command)
+		return COMMAND_NONE;
+
+	// The word (or file name, or option) and the argument that follows
+	char *word = io_next_token(in);
+	char *arg = io_next_token(in);
+
+	// Which command is it?
+	int code = which_command(command);
+
+	STATS_CLOCK(start);
+	switch (code) {
+	case INSERT:
+	case REMOVE:
+	case LOAD:
+	case LOADFREQ:
+	case COMPACT:
+	case FREEZE:
+	case SAVE:
+	case OPEN:
+		command_change(trie, code, word);
+		break;
+
+	case AUTOCORRECT:
+		// Autocorrect the word, with a tolerance or "EDIT <k>"
+		if (!word || !arg)
+			break;
+		if (strcmp(arg, "EDIT") == 0)
+			trie_autocorrect_edit(trie, word,
+								  command_number(io_next_token(in)));
+		else
+			trie_autocorrect(trie, word, atoi(arg));
+		break;
+
+	case AUTOCOMPLETE:
+		// Autocomplete the word
+		if (word && arg)
+			command_autocomplete(trie, in, word, arg);
+		break;
+
+	case BATCH:
+		// Answer the AUTOCOMPLETE queries of the next lines at once
+		command_batch(in, trie, command_number(word));
+		break;
+
+	case MEMORY:
+		// Print how much memory the trie uses
+		trie_memory_report(trie);
+		break;
+
+	case CACHE:
+		// Print the hit rate and the latency of the cached queries
+		cache_report(trie->cache, trie->out);
+		break;
+
+	case STATS:
+		// Print the size of the trie and the counters of the queries
+		stats_report(trie);
+		break;
+
+	case SET:
+		// Change an option, like the AUTOCORRECT engine
+		if (word && arg)
+			trie_set_option(trie, word, arg);
+		break;
+
+	default:
+		// EXIT, or a wrong command
+		break;
+	}
+	STATS_COMMAND(trie, code, start);
+
+	return code;
+}
@@ -0,0 +1,20 @@
+/* <Copyright Niculici Mihai-Daniel 2023 > */
+
+#ifndef COMMAND_H_
+#define COMMAND_H_
+
+#include "trie.h"
+#include "io.h"
+
+/* Code returned for a line without a command, no command has it */
+#define COMMAND_NONE 0
+
+/* Room for the longest command name, AUTOCOMPLETE, and its '\0' */
+#define COMMAND_NAME_SIZE 16
+
+/* Most queries a BATCH reads, a larger count is lowered to it */
+#define COMMAND_BATCH_MAX 1048576
+
+int command_execute(trie_t *trie, io_reader_t *in);
+
+#endif /* COMMAND_H_ */
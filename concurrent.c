@@ -0,0 +1,291 @@
+/* <Copyright Niculici Mihai-Daniel 2023 > */
+
+#include "concurrent.h"
+
+/******************************************************************************
+ * This function enables the concurrent mode of a trie: from now on, its
+ * changes copy the paths they touch and publish a new version, so that
+ * reader threads can query it without locks (see concurrent_reader_begin).
+ * The changes themselves still come from a single writer thread.
+ *
+ * @param trie - A pointer to the trie data structure.
+ *
+ * @return result - 0 if the mode is enabled, -1 if the trie is frozen or
+ *                  mapped from a snapshot, whose nodes cannot be copied.
+ *****************************************************************************/
+int concurrent_enable(trie_t *trie)
+{
+	if (trie->concurrent)
+		return 0;
+	if (trie->frozen || trie->image)
+		return -1;
+
+	concurrent_t *concurrent = calloc(1, sizeof(concurrent_t));
+	DIE(!concurrent, "Failed to allocate the concurrent mode");
+
+	concurrent->retired = malloc(CONCURRENT_INITIAL_RETIRED *
+								 sizeof(concurrent_retired_t));
+	DIE(!concurrent->retired, "Failed to allocate the retired list");
+	concurrent->retired_cap = CONCURRENT_INITIAL_RETIRED;
+
+	concurrent->version = malloc(sizeof(trie_version_t));
+	DIE(!concurrent->version, "Failed to allocate the trie version");
+	concurrent->version->root = trie->root;
+	concurrent->version->nodes = trie->nodes;
+	concurrent->version->kids = trie->kids;
+
+	// The epochs of the readers start after CONCURRENT_IDLE
+	concurrent->epoch = CONCURRENT_IDLE + 1;
+	trie->concurrent = concurrent;
+
+	return 0;
+}
+
+/******************************************************************************
+ * This function returns the oldest epoch announced by a reader inside a
+ * query.
+ *
+ * @param concurrent - A pointer to the concurrent mode.
+ *
+ * @return epoch - The oldest epoch, UINT64_MAX if no reader is in a query.
+ *****************************************************************************/
+static u64 concurrent_oldest(concurrent_t *concurrent)
+{
+	u64 oldest = UINT64_MAX;
+
+	for (int i = 0; i < CONCURRENT_MAX_READERS; i++) {
+		u64 epoch = __atomic_load_n(&concurrent->readers[i].epoch,
+									__ATOMIC_SEQ_CST);
+
+		if (epoch != CONCURRENT_IDLE && epoch < oldest)
+			oldest = epoch;
+	}
+
+	return oldest;
+}
+
+/******************************************************************************
+ * This function frees the retired entries of the epochs before a given one:
+ * the nodes and their blocks go back to the arenas, the memory to the system.
+ *
+ * @param trie - A pointer to the trie data structure.
+ * @param oldest - The first epoch whose entries are kept.
+ *****************************************************************************/
+static void concurrent_reclaim(trie_t *trie, u64 oldest)
+{
+	concurrent_t *concurrent = trie->concurrent;
+	size_t n = 0;
+
+	while (n < concurrent->nretired && concurrent->retired[n].epoch < oldest) {
+		concurrent_retired_t *entry = &concurrent->retired[n++];
+
+		if (entry->memory) {
+			free(entry->memory);
+			continue;
+		}
+		if (entry->kind != TRIE_NODE_EMPTY)
+			trie_free_block(trie, entry->block, entry->kind);
+		trie_free_node(trie, entry->node);
+	}
+
+	if (n == 0)
+		return;
+	memmove(concurrent->retired, concurrent->retired + n,
+			(concurrent->nretired - n) * sizeof(concurrent_retired_t));
+	concurrent->nretired -= n;
+}
+
+/******************************************************************************
+ * This function adds an entry to the retired list, in the current epoch.
+ *
+ * @param concurrent - A pointer to the concurrent mode.
+ * @param entry - The entry, without its epoch.
+ *****************************************************************************/
+static void concurrent_retire(concurrent_t *concurrent,
+							  concurrent_retired_t entry)
+{
+	if (concurrent->nretired == concurrent->retired_cap) {
+		concurrent->retired_cap *= 2;
+		concurrent->retired = realloc(concurrent->retired,
+									  concurrent->retired_cap *
+									  sizeof(concurrent_retired_t));
+		DIE(!concurrent->retired, "Failed to grow the retired list");
+	}
+
+	entry.epoch = concurrent->epoch;
+	concurrent->retired[concurrent->nretired++] = entry;
+}
+
+/******************************************************************************
+ * This function retires a node that the writer replaced by its copy. The
+ * node and its children block stay untouched until no reader can see them.
+ *
+ * @param trie - A pointer to the trie data structure.
+ * @param node - The index of the node.
+ *****************************************************************************/
+void concurrent_retire_node(trie_t *trie, u32 node)
+{
+	concurrent_retired_t entry = {0, node, trie->nodes[node].children,
+								  trie->nodes[node].kind, NULL};
+
+	concurrent_retire(trie->concurrent, entry);
+}
+
+/******************************************************************************
+ * This function retires a block of memory that readers may still use, like
+ * the arena that a bigger one replaced.
+ *
+ * @param concurrent - A pointer to the concurrent mode.
+ * @param memory - The memory, allocated with malloc.
+ *****************************************************************************/
+void concurrent_retire_memory(concurrent_t *concurrent, void *memory)
+{
+	concurrent_retired_t entry = {0, TRIE_NIL, TRIE_NIL, TRIE_NODE_EMPTY,
+								  memory};
+
+	concurrent_retire(concurrent, entry);
+}
+
+/******************************************************************************
+ * This function publishes the current root of the trie to the readers, at
+ * the end of a change, and starts a new epoch. The queries that start after
+ * it see the change, the ones in progress finish on the old version, and
+ * what no query can see any more is freed.
+ *
+ * @param trie - A pointer to the trie data structure.
+ *****************************************************************************/
+void concurrent_publish(trie_t *trie)
+{
+	concurrent_t *concurrent = trie->concurrent;
+	trie_version_t *version = malloc(sizeof(trie_version_t));
+	DIE(!version, "Failed to allocate the trie version");
+
+	version->root = trie->root;
+	version->nodes = trie->nodes;
+	version->kids = trie->kids;
+
+	// The version is complete before it is published
+	concurrent_retire_memory(concurrent, concurrent->version);
+	__atomic_store_n(&concurrent->version, version, __ATOMIC_SEQ_CST);
+	__atomic_store_n(&concurrent->epoch, concurrent->epoch + 1,
+					 __ATOMIC_SEQ_CST);
+
+	concurrent_reclaim(trie, concurrent_oldest(concurrent));
+}
+
+/******************************************************************************
+ * This function disables the concurrent mode of a trie and frees everything
+ * that was retired. No reader may be left.
+ *
+ * @param trie - A pointer to the trie data structure.
+ *****************************************************************************/
+void concurrent_disable(trie_t *trie)
+{
+	if (!trie->concurrent)
+		return;
+
+	concurrent_reclaim(trie, UINT64_MAX);
+	free(trie->concurrent->version);
+	free(trie->concurrent->retired);
+	free(trie->concurrent);
+	trie->concurrent = NULL;
+}
+
+/******************************************************************************
+ * This function registers a reader thread of a trie in concurrent mode.
+ *
+ * @param trie - A pointer to the trie data structure.
+ * @param out - The buffer that collects the output of the reader's queries.
+ *
+ * @return reader - A pointer to the reader, NULL if there are already
+ *                  CONCURRENT_MAX_READERS of them.
+ *****************************************************************************/
+trie_reader_t *concurrent_reader_create(trie_t *trie, io_buffer_t *out)
+{
+	concurrent_t *concurrent = trie->concurrent;
+	int slot = 0;
+
+	// Take a free slot, other readers may be looking for one as well
+	while (slot < CONCURRENT_MAX_READERS) {
+		int expected = 0;
+
+		if (__atomic_compare_exchange_n(&concurrent->readers[slot].used,
+										&expected, 1, 0, __ATOMIC_SEQ_CST,
+										__ATOMIC_SEQ_CST))
+			break;
+		slot++;
+	}
+	if (slot == CONCURRENT_MAX_READERS)
+		return NULL;
+
+	trie_reader_t *reader = calloc(1, sizeof(trie_reader_t));
+	DIE(!reader, "Failed to allocate the reader");
+	reader->concurrent = concurrent;
+	reader->slot = slot;
+
+	// The view only has what the queries read besides the version
+	reader->view.alphabet_size = trie->alphabet_size;
+	memcpy(reader->view.alphabet, trie->alphabet, sizeof(trie->alphabet));
+	memcpy(reader->view.fold, trie->fold, sizeof(trie->fold));
+	reader->view.load_threads = 1;
+	reader->view.out = out;
+
+	// The word store follows the writer, so the queries walk the version
+	reader->view.scan_distance = -1;
+
+	return reader;
+}
+
+/******************************************************************************
+ * This function starts a query of a reader: the reader announces the current
+ * epoch, then takes the published version.
+ *
+ * @param reader - A pointer to the reader.
+ *
+ * @return view - The trie to run the query on, until concurrent_reader_end.
+ *****************************************************************************/
+trie_t *concurrent_reader_begin(trie_reader_t *reader)
+{
+	concurrent_t *concurrent = reader->concurrent;
+
+	__atomic_store_n(&concurrent->readers[reader->slot].epoch,
+					 __atomic_load_n(&concurrent->epoch, __ATOMIC_SEQ_CST),
+					 __ATOMIC_SEQ_CST);
+
+	trie_version_t *version = __atomic_load_n(&concurrent->version,
+											  __ATOMIC_SEQ_CST);
+
+	reader->view.root = version->root;
+	reader->view.nodes = version->nodes;
+	reader->view.kids = version->kids;
+
+	return &reader->view;
+}
+
+/******************************************************************************
+ * This function ends a query of a reader, so that the versions it saw can be
+ * freed.
+ *
+ * @param reader - A pointer to the reader.
+ *****************************************************************************/
+void concurrent_reader_end(trie_reader_t *reader)
+{
+	__atomic_store_n(&reader->concurrent->readers[reader->slot].epoch,
+					 CONCURRENT_IDLE, __ATOMIC_RELEASE);
+}
+
+/******************************************************************************
+ * This function unregisters a reader and frees it.
+ *
+ * @param preader - A double pointer to the reader.
+ *****************************************************************************/
+void concurrent_reader_free(trie_reader_t **preader)
+{
+	trie_reader_t *reader = *preader;
+
+	concurrent_reader_end(reader);
+	__atomic_store_n(&reader->concurrent->readers[reader->slot].used, 0,
+					 __ATOMIC_RELEASE);
+	free(reader);
+	*preader = NULL;
+}
@@ -0,0 +1,91 @@
+/* <Copyright Niculici Mihai-Daniel 2023 > */
+
+#ifndef CONCURRENT_H_
+#define CONCURRENT_H_
+
+#include "trie.h"
+
+/* Most reader threads that may query a trie at the same time */
+#define CONCURRENT_MAX_READERS 64
+
+/* Number of retired entries reserved when the mode is enabled */
+#define CONCURRENT_INITIAL_RETIRED 1024
+
+/* Epoch announced by a reader that is not inside a query */
+#define CONCURRENT_IDLE 0
+
+/*
+ * Version of the trie published to the readers: the root and the arenas it
+ * lives in. Nothing that a published version can reach is changed again.
+ */
+typedef struct trie_version_t trie_version_t;
+struct trie_version_t {
+	u32 root;
+	trie_node_t *nodes;
+	u32 *kids;
+};
+
+/*
+ * Something the writer replaced, freed once no reader can still see it:
+ * a node of an older version, with its children block, or a block of memory
+ * (an old arena or an old version).
+ */
+typedef struct concurrent_retired_t concurrent_retired_t;
+struct concurrent_retired_t {
+	u64 epoch;
+	u32 node;
+	u32 block;
+	u8 kind;
+	void *memory;
+};
+
+/* Epoch of a reader thread, alone on its cache line */
+typedef struct concurrent_slot_t concurrent_slot_t;
+struct concurrent_slot_t {
+	u64 epoch;
+	int used;
+	char padding[64 - sizeof(u64) - sizeof(int)];
+};
+
+/*
+ * State of the concurrent mode of a trie. One writer changes the trie by
+ * copying the path of every change (copy-on-write) and publishes the new
+ * root with an atomic swap, so the readers never wait for it. A reader
+ * announces the epoch in which it started a query; what the writer retires
+ * in an epoch is freed once every reader inside a query has a later one.
+ */
+typedef struct concurrent_t concurrent_t;
+struct concurrent_t {
+	u64 epoch;
+	trie_version_t *version;
+	concurrent_slot_t readers[CONCURRENT_MAX_READERS];
+
+	/* The retired entries, in the order of their epochs */
+	concurrent_retired_t *retired;
+	size_t nretired;
+	size_t retired_cap;
+};
+
+/*
+ * A reader thread. Its view is a trie_t with the alphabet of the trie and
+ * its own output buffer, that points at the published version during a
+ * query.
+ */
+typedef struct trie_reader_t trie_reader_t;
+struct trie_reader_t {
+	concurrent_t *concurrent;
+	int slot;
+	trie_t view;
+};
+
+int concurrent_enable(trie_t *trie);
+void concurrent_disable(trie_t *trie);
+void concurrent_retire_node(trie_t *trie, u32 node);
+void concurrent_retire_memory(concurrent_t *concurrent, void *memory);
+void concurrent_publish(trie_t *trie);
+trie_reader_t *concurrent_reader_create(trie_t *trie, io_buffer_t *out);
+trie_t *concurrent_reader_begin(trie_reader_t *reader);
+void concurrent_reader_end(trie_reader_t *reader);
+void concurrent_reader_free(trie_reader_t **preader);
+
+#endif /* CONCURRENT_H_ */
@@ -0,0 +1,209 @@
+/* <Copyright Niculici Mihai-Daniel 2023 > */
+
+#include "datrie.h"
+
+/******************************************************************************
+ * This function grows the arrays of a double array until they have a given
+ * number of cells. The new cells are free.
+ *
+ * @param datrie - A pointer to the double array.
+ * @param ncells - The number of cells needed.
+ *****************************************************************************/
+static void datrie_reserve(datrie_t *datrie, u32 ncells)
+{
+	u32 old = datrie->ncells;
+
+	if (ncells <= old)
+		return;
+	while (datrie->ncells < ncells)
+		datrie->ncells *= 2;
+
+	datrie->base = realloc(datrie->base, datrie->ncells * sizeof(s32));
+	datrie->check = realloc(datrie->check, datrie->ncells * sizeof(s32));
+	datrie->node = realloc(datrie->node, datrie->ncells * sizeof(u32));
+	DIE(!datrie->base || !datrie->check || !datrie->node,
+		"Failed to grow the double array");
+
+	for (u32 i = old; i < datrie->ncells; i++)
+		datrie->check[i] = DATRIE_FREE;
+}
+
+/******************************************************************************
+ * This function finds the first base whose cells are free for all the
+ * letters of the children of a state, trying the free cells in order for the
+ * first letter. The arrays are grown to hold the cells of the base.
+ *
+ * @param datrie - A pointer to the double array.
+ * @param first_free - The first free cell.
+ * @param letters - The letters of the children, in increasing order.
+ * @param n - The number of children, at least one.
+ * @param alphabet_size - The number of letters of the alphabet.
+ *
+ * @return base - The base, at least 1.
+ *****************************************************************************/
+static s32 datrie_find_base(datrie_t *datrie, u32 first_free,
+							u8 *letters, int n, int alphabet_size)
+{
+	u32 cell = first_free;
+
+	while (1) {
+		datrie_reserve(datrie, cell + alphabet_size);
+
+		s32 base = (s32)cell - letters[0];
+
+		if (datrie->check[cell] == DATRIE_FREE && base >= 1) {
+			int i = 1;
+
+			while (i < n && datrie->check[base + letters[i]] == DATRIE_FREE)
+				i++;
+			if (i == n)
+				return base;
+		}
+		cell++;
+	}
+}
+
+/******************************************************************************
+ * This function builds the double array of a trie. The states are placed in
+ * breadth-first order: for every state, the first base (first fit, from the
+ * first free cell) whose cells are free for all the letters of its children
+ * is taken. A frozen trie is unfolded, every path gets its own state.
+ *
+ * @param trie - A pointer to the trie data structure.
+ *
+ * @return datrie - A pointer to the double array created.
+ *****************************************************************************/
+datrie_t *datrie_build(trie_t *trie)
+{
+	u8 letters[TRIE_MAX_ALPHABET];
+	u32 children[TRIE_MAX_ALPHABET];
+	u32 first_free = 1;
+	s32 max_base = 0;
+
+	datrie_t *datrie = malloc(sizeof(datrie_t));
+	DIE(!datrie, "Failed to allocate the double array");
+	datrie->base = NULL;
+	datrie->check = NULL;
+	datrie->node = NULL;
+	datrie->ncells = 1;
+	datrie_reserve(datrie, DATRIE_INITIAL_CELLS > 2 * (u32)trie->nnodes ?
+				   DATRIE_INITIAL_CELLS : 2 * (u32)trie->nnodes);
+
+	// The root is cell 0, its own parent
+	datrie->check[0] = 0;
+	datrie->node[0] = trie->root;
+	datrie->nstates = 1;
+
+	// The states waiting for their children, in breadth-first order
+	u32 *queue = malloc(datrie->ncells * sizeof(u32));
+	DIE(!queue, "Failed to allocate the double array queue");
+	u32 head = 0, tail = 0, queue_cap = datrie->ncells;
+
+	queue[tail++] = 0;
+	while (head < tail) {
+		u32 state = queue[head++];
+		int n = trie_children(trie, datrie->node[state], letters, children);
+
+		// A leaf has no cell with itself as parent, whatever its base
+		if (n == 0) {
+			datrie->base[state] = 0;
+			continue;
+		}
+
+		s32 base = datrie_find_base(datrie, first_free, letters, n,
+									trie->alphabet_size);
+
+		datrie->base[state] = base;
+		if (base > max_base)
+			max_base = base;
+		for (int i = 0; i < n; i++) {
+			u32 child = base + letters[i];
+
+			datrie->check[child] = state;
+			datrie->node[child] = children[i];
+			datrie->nstates++;
+
+			if (tail == queue_cap) {
+				queue_cap *= 2;
+				queue = realloc(queue, queue_cap * sizeof(u32));
+				DIE(!queue, "Failed to grow the double array queue");
+			}
+			queue[tail++] = child;
+		}
+
+		while (first_free < datrie->ncells &&
+			   datrie->check[first_free] != DATRIE_FREE)
+			first_free++;
+	}
+
+	free(queue);
+
+	// Keep only the cells that a lookup can reach
+	datrie->ncells = max_base + trie->alphabet_size;
+	datrie->base = realloc(datrie->base, datrie->ncells * sizeof(s32));
+	datrie->check = realloc(datrie->check, datrie->ncells * sizeof(s32));
+	datrie->node = realloc(datrie->node, datrie->ncells * sizeof(u32));
+	DIE(!datrie->base || !datrie->check || !datrie->node,
+		"Failed to shrink the double array");
+
+	return datrie;
+}
+
+/******************************************************************************
+ * This function walks the double array along a prefix, with two array reads
+ * for every letter.
+ *
+ * @param datrie - A pointer to the double array.
+ * @param fold - The tokenizer table of the trie, that gives the letters.
+ * @param prefix - The prefix to match.
+ *
+ * @return node - The node of the trie for the prefix, TRIE_NIL if no word
+ *                starts with the prefix.
+ *****************************************************************************/
+u32 datrie_find_prefix(datrie_t *datrie, const u8 *fold,
+					   char *prefix)
+{
+	s32 state = 0;
+
+	for (int i = 0; prefix[i]; i++) {
+		int letter = fold[(unsigned char)prefix[i]] - 1;
+
+		if (letter < 0)
+			return TRIE_NIL;
+
+		s32 next = datrie->base[state] + letter;
+
+		if (datrie->check[next] != state || next == 0)
+			return TRIE_NIL;
+		state = next;
+	}
+
+	return datrie->node[state];
+}
+
+/******************************************************************************
+ * This function returns the number of bytes used by a double array.
+ *
+ * @param datrie - A pointer to the double array.
+ *
+ * @return bytes - The size of the structure and of its arrays.
+ *****************************************************************************/
+size_t datrie_memory_usage(datrie_t *datrie)
+{
+	return sizeof(datrie_t) + (size_t)datrie->ncells *
+		   (2 * sizeof(s32) + sizeof(u32));
+}
+
+/******************************************************************************
+ * This function frees the memory allocated by a double array.
+ *
+ * @param pdatrie - A double pointer to the double array.
+ *****************************************************************************/
+void datrie_free(datrie_t **pdatrie)
+{
+	free((*pdatrie)->base);
+	free((*pdatrie)->check);
+	free((*pdatrie)->node);
+	free(*pdatrie);
+	*pdatrie = NULL;
+}
@@ -0,0 +1,38 @@
+/* <Copyright Niculici Mihai-Daniel 2023 > */
+
+#ifndef DATRIE_H_
+#define DATRIE_H_
+
+#include "trie.h"
+
+/* Value of check for a cell that holds no state */
+#define DATRIE_FREE -1
+
+/* Number of cells reserved when the double array is built, at least */
+#define DATRIE_INITIAL_CELLS 1024
+
+/*
+ * Double-array trie, built from the nodes of a trie_t (SET backend datrie).
+ * Every state is a cell: the child of state s for a letter c is the cell
+ * t = base[s] + c, if check[t] == s. The root is cell 0 and node[] gives,
+ * for every state, the node of the trie that holds its word and summaries.
+ * It is read-only, any change of the trie drops it.
+ */
+typedef struct datrie_t datrie_t;
+struct datrie_t {
+	s32 *base;
+	s32 *check;
+	u32 *node;
+
+	/* Number of cells allocated, and of states */
+	u32 ncells;
+	u32 nstates;
+};
+
+datrie_t *datrie_build(trie_t *trie);
+u32 datrie_find_prefix(datrie_t *datrie, const u8 *fold,
+					   char *prefix);
+size_t datrie_memory_usage(datrie_t *datrie);
+void datrie_free(datrie_t **pdatrie);
+
+#endif /* DATRIE_H_ */
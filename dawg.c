@@ -0,0 +1,492 @@
+/* <Copyright Niculici Mihai-Daniel 2023 > */
+
+#include "dawg.h"
+
+/******************************************************************************
+ * This function computes the hash of a node of the DAWG from its own word
+ * flag and its children, which are already nodes of the DAWG.
+ *
+ * @param end_of_word - 1 if a word ends in the node, 0 otherwise.
+ * @param n - The number of children.
+ * @param letters - The letters of the children.
+ * @param children - The indices of the children in the DAWG.
+ *
+ * @return hash - The 32-bit FNV-1a hash of the node.
+ *****************************************************************************/
+static u32 dawg_hash(int end_of_word, int n, u8 *letters,
+					 u32 *children)
+{
+	u32 hash = 2166136261u;
+
+	hash = (hash ^ end_of_word) * 16777619u;
+	for (int i = 0; i < n; i++) {
+		hash = (hash ^ letters[i]) * 16777619u;
+		hash = (hash ^ children[i]) * 16777619u;
+	}
+
+	return hash;
+}
+
+/******************************************************************************
+ * This function checks if a node of the DAWG has the given word flag and
+ * children, so that it can stand for another subtree.
+ *
+ * @param dawg - The trie that holds the DAWG being built.
+ * @param node - The index of the node of the DAWG.
+ * @param end_of_word - 1 if a word ends in the subtree root, 0 otherwise.
+ * @param n - The number of children of the subtree root.
+ * @param letters - The letters of the children.
+ * @param children - The indices of the children in the DAWG.
+ *
+ * @return result - 1 if the node is equivalent, 0 otherwise.
+ *****************************************************************************/
+static int dawg_same(trie_t *dawg, u32 node, int end_of_word, int n,
+					 u8 *letters, u32 *children)
+{
+	u8 other_letters[TRIE_MAX_ALPHABET];
+	u32 other_children[TRIE_MAX_ALPHABET];
+
+	if (dawg->nodes[node].end_of_word != end_of_word ||
+		dawg->nodes[node].n_children != n)
+		return 0;
+
+	trie_children(dawg, node, other_letters, other_children);
+	for (int i = 0; i < n; i++)
+		if (other_letters[i] != letters[i] ||
+			other_children[i] != children[i])
+			return 0;
+
+	return 1;
+}
+
+/******************************************************************************
+ * This function builds the DAWG of a subtree, bottom-up: the children are
+ * built first, then the subtree is replaced by the node of the DAWG that has
+ * the same word flag and the same children, if there is one. Two such
+ * subtrees hold the same words, so they also have the same summaries, except
+ * for the frequencies, which go to the table of ranks, in lexicographic order.
+ *
+ * @param trie - A pointer to the trie data structure.
+ * @param dawg - The trie that holds the DAWG being built.
+ * @param reg - The hash table of the nodes of the DAWG.
+ * @param node - The index of the root of the subtree.
+ * @param freqs - The table of the frequencies, by rank.
+ * @param rank - A pointer to the rank of the next word.
+ *
+ * @return node - The index of the node of the DAWG for the subtree.
+ *****************************************************************************/
+static u32 dawg_build(trie_t *trie, trie_t *dawg, dawg_register_t *reg,
+					  u32 node, int *freqs, u32 *rank)
+{
+	u8 letters[TRIE_MAX_ALPHABET];
+	u32 children[TRIE_MAX_ALPHABET];
+	int n = trie_children(trie, node, letters, children), live = 0;
+	trie_node_t *current = &trie->nodes[node];
+	int end_of_word = current->end_of_word != 0;
+
+	// The word of the node comes before the words of its children
+	if (end_of_word)
+		freqs[(*rank)++] = current->end_of_word;
+
+	// The branches that REMOVE left without words are not copied
+	for (int i = 0; i < n; i++) {
+		if (trie->nodes[children[i]].nwords == 0)
+			continue;
+		letters[live] = letters[i];
+		children[live++] = dawg_build(trie, dawg, reg, children[i], freqs,
+									  rank);
+	}
+	n = live;
+
+	// The root holds every word, no other subtree can be the same
+	u32 hash = dawg_hash(end_of_word, n, letters, children);
+	u32 slot = hash & (reg->nslots - 1);
+
+	if (node != trie->root) {
+		while (reg->nodes[slot] != TRIE_NIL) {
+			if (reg->hashes[slot] == hash &&
+				dawg_same(dawg, reg->nodes[slot], end_of_word, n, letters,
+						  children))
+				return reg->nodes[slot];
+			slot = (slot + 1) & (reg->nslots - 1);
+		}
+	}
+
+	u32 copy = dawg->root;
+
+	if (node != trie->root) {
+		copy = trie_create_node(dawg);
+		dawg->nnodes++;
+		reg->nodes[slot] = copy;
+		reg->hashes[slot] = hash;
+	}
+
+	for (int i = 0; i < n; i++)
+		trie_set_child(dawg, copy, letters[i], children[i]);
+
+	// Only the summaries that depend on the words alone are kept
+	trie_node_t *frozen = &dawg->nodes[copy];
+
+	frozen->end_of_word = end_of_word;
+	frozen->lex_dir = current->lex_dir;
+	frozen->short_dir = current->short_dir;
+	frozen->short_len = current->short_len;
+	frozen->len_mask = current->len_mask;
+	frozen->nwords = current->nwords;
+
+	return copy;
+}
+
+/******************************************************************************
+ * This function returns the rank of the most frequent word of two, the
+ * smallest rank (so the lexicographically smallest word) on equal
+ * frequencies.
+ *
+ * @param freqs - The table of the frequencies, by rank.
+ * @param a - The first rank, or DAWG_NO_RANK.
+ * @param b - The second rank, or DAWG_NO_RANK.
+ *
+ * @return rank - The rank of the best word.
+ *****************************************************************************/
+static u32 dawg_better(int *freqs, u32 a, u32 b)
+{
+	if (a == DAWG_NO_RANK)
+		return b;
+	if (b == DAWG_NO_RANK)
+		return a;
+	if (freqs[a] != freqs[b])
+		return freqs[a] > freqs[b] ? a : b;
+	return a < b ? a : b;
+}
+
+/******************************************************************************
+ * This function returns the rank of the most frequent word in a range of
+ * ranks, from the segment tree of the trie.
+ *
+ * @param trie - A pointer to the trie data structure, frozen.
+ * @param lo - The first rank of the range.
+ * @param hi - The rank after the last one of the range.
+ *
+ * @return rank - The rank of the best word, DAWG_NO_RANK for an empty range.
+ *****************************************************************************/
+static u32 dawg_range_max(trie_t *trie, u32 lo, u32 hi)
+{
+	u32 best = DAWG_NO_RANK;
+
+	// The leaves of the tree are after its nwords - 1 inner nodes
+	for (lo += trie->nwords, hi += trie->nwords; lo < hi; lo /= 2, hi /= 2) {
+		if (lo & 1)
+			best = dawg_better(trie->freqs, best, trie->freq_max[lo++]);
+		if (hi & 1)
+			best = dawg_better(trie->freqs, best, trie->freq_max[--hi]);
+	}
+
+	return best;
+}
+
+/******************************************************************************
+ * This function minimizes the trie into a directed acyclic word graph: all
+ * the subtrees that hold the same words (like the ones of the shared endings
+ * "ing", "tion" or "ness") become a single node. The nodes keep the same
+ * format, so the searches that only follow letters and the summaries of the
+ * shortest and lexicographically smallest words run unchanged. The
+ * frequencies move to a table indexed by the lexicographic rank of the
+ * words, with a segment tree that finds the most frequent word of a range.
+ *
+ * @param trie - A pointer to the trie data structure.
+ *****************************************************************************/
+void dawg_freeze(trie_t *trie)
+{
+	dawg_register_t reg;
+	u32 rank = 0;
+	u32 nwords = trie->nwords;
+
+	// The readers of the concurrent mode walk the nodes of the tree
+	if (trie->frozen || trie->concurrent)
+		return;
+
+	// The register is kept at most half full
+	for (reg.nslots = 1; reg.nslots < 2 * trie->nodes_used; reg.nslots *= 2)
+		;
+	reg.nodes = calloc(reg.nslots, sizeof(u32));
+	DIE(!reg.nodes, "Failed to allocate the DAWG register");
+	reg.hashes = malloc(reg.nslots * sizeof(u32));
+	DIE(!reg.hashes, "Failed to allocate the DAWG register");
+
+	int *freqs = malloc((nwords + 1) * sizeof(int));
+	DIE(!freqs, "Failed to allocate the frequency table");
+
+	trie_t *dawg = trie_create(trie->alphabet_size, trie->alphabet);
+
+	dawg_build(trie, dawg, &reg, trie->root, freqs, &rank);
+	free(reg.nodes);
+	free(reg.hashes);
+
+	// Nothing is added to a frozen trie, so the arenas are cut to size
+	dawg->nodes = realloc(dawg->nodes, dawg->nodes_used * sizeof(trie_node_t));
+	DIE(!dawg->nodes, "Failed to shrink the DAWG node arena");
+	dawg->nodes_cap = dawg->nodes_used;
+	dawg->kids = realloc(dawg->kids, dawg->kids_used * sizeof(u32));
+	DIE(!dawg->kids, "Failed to shrink the DAWG child pool");
+	dawg->kids_cap = dawg->kids_used;
+
+	// The segment tree: leaf nwords + r is rank r, node i is the best of
+	// nodes 2i and 2i + 1
+	u32 *freq_max = malloc((2 * nwords + 1) * sizeof(u32));
+	DIE(!freq_max, "Failed to allocate the frequency segment tree");
+
+	for (u32 i = 0; i < nwords; i++)
+		freq_max[nwords + i] = i;
+	for (u32 i = nwords; i-- > 1;)
+		freq_max[i] = dawg_better(freqs, freq_max[2 * i], freq_max[2 * i + 1]);
+
+	// The trie takes the arenas of the DAWG
+	trie_take_arenas(trie, dawg);
+	trie->freqs = freqs;
+	trie->freq_max = freq_max;
+	trie->frozen = 1;
+}
+
+/******************************************************************************
+ * This function copies a subtree of the DAWG into a tree, giving back to
+ * every word its frequency, and computes the summaries of the copy.
+ *
+ * @param trie - A pointer to the trie data structure, frozen.
+ * @param tree - The trie that holds the tree being built.
+ * @param node - The index of the node of the DAWG.
+ * @param copy - The index of its copy in the tree.
+ * @param rank - A pointer to the rank of the next word.
+ *****************************************************************************/
+static void dawg_unfold(trie_t *trie, trie_t *tree, u32 node,
+						u32 copy, u32 *rank)
+{
+	u8 letters[TRIE_MAX_ALPHABET];
+	u32 children[TRIE_MAX_ALPHABET];
+	int n = trie_children(trie, node, letters, children);
+
+	if (trie->nodes[node].end_of_word != 0)
+		tree->nodes[copy].end_of_word = trie->freqs[(*rank)++];
+
+	for (int i = 0; i < n; i++) {
+		u32 child = trie_create_node(tree);
+
+		tree->nnodes++;
+		trie_set_child(tree, copy, letters[i], child);
+		dawg_unfold(trie, tree, children[i], child, rank);
+	}
+
+	trie_update_summary(tree, copy);
+}
+
+/******************************************************************************
+ * This function turns a frozen trie back into a tree that can be changed,
+ * with the same words and frequencies.
+ *
+ * @param trie - A pointer to the trie data structure.
+ *****************************************************************************/
+void dawg_thaw(trie_t *trie)
+{
+	u32 rank = 0;
+
+	if (!trie->frozen)
+		return;
+
+	trie_t *tree = trie_create(trie->alphabet_size, trie->alphabet);
+
+	dawg_unfold(trie, tree, trie->root, tree->root, &rank);
+
+	// The trie takes the arenas of the tree, the frequency tables go away
+	trie_take_arenas(trie, tree);
+	trie->frozen = 0;
+}
+
+/******************************************************************************
+ * This function walks a frozen trie along a prefix, counting the words that
+ * come before it in lexicographic order.
+ *
+ * @param trie - A pointer to the trie data structure, frozen.
+ * @param prefix - The prefix to match.
+ * @param rank - A pointer to the rank of the first word with the prefix.
+ *
+ * @return node - The index of the node of the prefix, TRIE_NIL if no word
+ *                starts with the prefix.
+ *****************************************************************************/
+u32 dawg_find_prefix(trie_t *trie, char *prefix, u32 *rank)
+{
+	u8 letters[TRIE_MAX_ALPHABET];
+	u32 children[TRIE_MAX_ALPHABET];
+	u32 node = trie->root;
+
+	*rank = 0;
+	for (int i = 0; prefix[i]; i++) {
+		int letter = trie->fold[(unsigned char)prefix[i]] - 1;
+		int n = trie_children(trie, node, letters, children), j;
+
+		// The word of the node and the smaller children come first
+		if (trie->nodes[node].end_of_word != 0)
+			(*rank)++;
+		for (j = 0; j < n && letters[j] < letter; j++)
+			*rank += trie->nodes[children[j]].nwords;
+
+		if (j == n || letters[j] != letter)
+			return TRIE_NIL;
+		node = children[j];
+	}
+
+	return node;
+}
+
+/******************************************************************************
+ * This function appends to a word the letters of the word with a given rank
+ * in a subtree of a frozen trie.
+ *
+ * @param trie - A pointer to the trie data structure, frozen.
+ * @param node - The index of the root of the subtree.
+ * @param rank - The rank of the word in the subtree.
+ * @param word - The buffer of the word.
+ * @param len - The length of the word before the letters are appended.
+ *
+ * @return len - The length of the word after the letters are appended.
+ *****************************************************************************/
+static int dawg_word(trie_t *trie, u32 node, u32 rank, char *word,
+					 int len)
+{
+	u8 letters[TRIE_MAX_ALPHABET];
+	u32 children[TRIE_MAX_ALPHABET];
+
+	while (1) {
+		if (trie->nodes[node].end_of_word != 0) {
+			if (rank == 0)
+				return len;
+			rank--;
+		}
+
+		// Skip the children whose words all come before the rank
+		int n = trie_children(trie, node, letters, children), i = 0;
+
+		while (i < n - 1 && rank >= trie->nodes[children[i]].nwords)
+			rank -= trie->nodes[children[i++]].nwords;
+
+		word[len++] = trie->alphabet[letters[i]];
+		node = children[i];
+	}
+}
+
+/******************************************************************************
+ * This function finds the most frequent word that starts with a prefix in a
+ * frozen trie, the lexicographically smallest on equal frequencies.
+ *
+ * @param trie - A pointer to the trie data structure, frozen.
+ * @param prefix - The prefix to match.
+ * @param word - Buffer of MAX_STRING_SIZE bytes for the word.
+ *
+ * @return len - The length of the word, -1 if no word starts with the prefix.
+ *****************************************************************************/
+int dawg_autocomplete_frequent(trie_t *trie, char *prefix, char *word)
+{
+	int len = strlen(prefix);
+	u32 rank, node = dawg_find_prefix(trie, prefix, &rank);
+
+	if (node == TRIE_NIL || trie->nodes[node].nwords == 0)
+		return -1;
+
+	u32 best = dawg_range_max(trie, rank,
+							  rank + trie->nodes[node].nwords);
+
+	memcpy(word, prefix, len);
+	return dawg_word(trie, node, best - rank, word, len);
+}
+
+/******************************************************************************
+ * This function compares two ranges of the search of AUTOCOMPLETE TOP.
+ *
+ * @param trie - A pointer to the trie data structure, frozen.
+ * @param a - The first range.
+ * @param b - The second range.
+ *
+ * @return result - 1 if the best word of a comes before the one of b.
+ *****************************************************************************/
+static int dawg_range_before(trie_t *trie, dawg_range_t *a, dawg_range_t *b)
+{
+	return dawg_better(trie->freqs, a->best, b->best) == a->best;
+}
+
+/******************************************************************************
+ * This function prints the n most frequent words that start with a prefix in
+ * a frozen trie, in the same order as trie_autocomplete_top.
+ *
+ * The words of the prefix have consecutive ranks. A heap holds ranges of
+ * ranks, ranked by their most frequent word: the best range is taken out, its
+ * word is printed and the two ranges around the word go back in the heap.
+ *
+ * @param trie - A pointer to the trie data structure, frozen.
+ * @param prefix - The prefix to match.
+ * @param n - The number of words to print.
+ *****************************************************************************/
+void dawg_autocomplete_top(trie_t *trie, char *prefix, int n)
+{
+	char word[MAX_STRING_SIZE];
+	int plen = strlen(prefix), size = 0;
+	u32 rank, node = dawg_find_prefix(trie, prefix, &rank);
+
+	if (node == TRIE_NIL || trie->nodes[node].nwords == 0) {
+		io_write_line(trie->out, "No words found", 14);
+		return;
+	}
+	if (n <= 0)
+		return;
+
+	// Every word printed adds at most one range to the heap
+	if ((u32)n > trie->nodes[node].nwords)
+		n = trie->nodes[node].nwords;
+	dawg_range_t *heap = malloc((n + 1) * sizeof(dawg_range_t));
+	DIE(!heap, "Failed to allocate memory for the autocomplete heap");
+
+	memcpy(word, prefix, plen);
+	heap[size++] = (dawg_range_t){rank, rank + trie->nodes[node].nwords,
+		dawg_range_max(trie, rank, rank + trie->nodes[node].nwords)};
+
+	while (size > 0 && n-- > 0) {
+		dawg_range_t top = heap[0], last = heap[--size];
+		int i = 0;
+
+		// Sift the last range down from the top
+		while (2 * i + 1 < size) {
+			int child = 2 * i + 1;
+
+			if (child + 1 < size &&
+				dawg_range_before(trie, &heap[child + 1], &heap[child]))
+				child++;
+			if (!dawg_range_before(trie, &heap[child], &last))
+				break;
+			heap[i] = heap[child];
+			i = child;
+		}
+		heap[i] = last;
+
+		io_write_line(trie->out, word,
+					  dawg_word(trie, node, top.best - rank, word, plen));
+
+		// The words before and after the one printed
+		dawg_range_t parts[2] = {
+			{top.lo, top.best, dawg_range_max(trie, top.lo, top.best)},
+			{top.best + 1, top.hi, dawg_range_max(trie, top.best + 1, top.hi)}
+		};
+
+		for (int j = 0; j < 2; j++) {
+			if (parts[j].lo == parts[j].hi)
+				continue;
+
+			// Sift the range up while it comes before its parent
+			i = size++;
+			while (i > 0 &&
+				   dawg_range_before(trie, &parts[j], &heap[(i - 1) / 2])) {
+				heap[i] = heap[(i - 1) / 2];
+				i = (i - 1) / 2;
+			}
+			heap[i] = parts[j];
+		}
+	}
+
+	free(heap);
+}
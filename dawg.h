@@ -0,0 +1,40 @@
+/* <Copyright Niculici Mihai-Daniel 2023 > */
+
+#ifndef DAWG_H_
+#define DAWG_H_
+
+#include "trie.h"
+
+/* Rank of no word, the most frequent rank of an empty range */
+#define DAWG_NO_RANK 0xFFFFFFFFu
+
+/*
+ * Hash table of the nodes of the DAWG, used while it is built to find the
+ * node already created for a subtree with the same words. A slot keeps the
+ * index of the node (TRIE_NIL if the slot is empty) and its hash.
+ */
+typedef struct dawg_register_t dawg_register_t;
+struct dawg_register_t {
+	u32 *nodes;
+	u32 *hashes;
+	u32 nslots;
+};
+
+/*
+ * Entry of the search of AUTOCOMPLETE TOP on a frozen trie: a range of word
+ * ranks, ranked by its most frequent word.
+ */
+typedef struct dawg_range_t dawg_range_t;
+struct dawg_range_t {
+	u32 lo;
+	u32 hi;
+	u32 best;
+};
+
+void dawg_freeze(trie_t *trie);
+void dawg_thaw(trie_t *trie);
+u32 dawg_find_prefix(trie_t *trie, char *prefix, u32 *rank);
+int dawg_autocomplete_frequent(trie_t *trie, char *prefix, char *word);
+void dawg_autocomplete_top(trie_t *trie, char *prefix, int n);
+
+#endif /* DAWG_H_ */
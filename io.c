@@ -0,0 +1,584 @@
+/* <Copyright Niculici Mihai-Daniel 2023 > */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <ctype.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include "io.h"
+
+/******************************************************************************
+ * This function creates an empty ring of blocks.
+ *
+ * @return ring - A pointer to the ring.
+ *****************************************************************************/
+static io_ring_t *io_ring_create(void)
+{
+	io_ring_t *ring = malloc(sizeof(*ring));
+
+	DIE(!ring, "Failed to allocate the ring");
+	ring->head = 0;
+	ring->tail = 0;
+	DIE(sem_init(&ring->filled, 0, 0) < 0, "Failed to create the ring");
+	DIE(sem_init(&ring->empty, 0, IO_RING_SLOTS) < 0,
+		"Failed to create the ring");
+
+	return ring;
+}
+
+/******************************************************************************
+ * This function waits for a semaphore, again if a signal interrupts it.
+ *
+ * @param sem - A pointer to the semaphore.
+ *****************************************************************************/
+static void io_ring_wait(sem_t *sem)
+{
+	while (sem_wait(sem) < 0)
+		DIE(errno != EINTR, "Failed to wait for the ring");
+}
+
+/******************************************************************************
+ * This function adds a block at the end of a ring, after waiting for a free
+ * slot. Only one thread may add blocks to a ring.
+ *
+ * @param ring - A pointer to the ring.
+ * @param data - The block, which the ring now owns, or NULL for the end.
+ * @param len - The number of bytes of the block.
+ *****************************************************************************/
+static void io_ring_push(io_ring_t *ring, char *data, size_t len)
+{
+	io_ring_wait(&ring->empty);
+	ring->data[ring->tail % IO_RING_SLOTS] = data;
+	ring->len[ring->tail % IO_RING_SLOTS] = len;
+	ring->tail++;
+	sem_post(&ring->filled);
+}
+
+/******************************************************************************
+ * This function takes the first block of a ring, after waiting for one. Only
+ * one thread may take blocks from a ring.
+ *
+ * @param ring - A pointer to the ring.
+ * @param len - Where the number of bytes of the block is stored.
+ *
+ * @return data - The block, which the caller now owns, or NULL at the end.
+ *****************************************************************************/
+static char *io_ring_pop(io_ring_t *ring, size_t *len)
+{
+	io_ring_wait(&ring->filled);
+
+	char *data = ring->data[ring->head % IO_RING_SLOTS];
+
+	*len = ring->len[ring->head % IO_RING_SLOTS];
+	ring->head++;
+	sem_post(&ring->empty);
+
+	return data;
+}
+
+/******************************************************************************
+ * This function frees a ring and the blocks still in it. No thread may use
+ * it any more.
+ *
+ * @param ring - A pointer to the ring.
+ *****************************************************************************/
+static void io_ring_free(io_ring_t *ring)
+{
+	while (sem_trywait(&ring->filled) == 0)
+		free(ring->data[ring->head++ % IO_RING_SLOTS]);
+	sem_destroy(&ring->filled);
+	sem_destroy(&ring->empty);
+	free(ring);
+}
+
+/******************************************************************************
+ * This function writes all the bytes of a block to a file descriptor.
+ *
+ * @param fd - The file descriptor.
+ * @param data - The bytes.
+ * @param len - The number of bytes.
+ *****************************************************************************/
+static void io_write_fd(int fd, const char *data, size_t len)
+{
+	size_t done = 0;
+
+	while (done < len) {
+		ssize_t n = write(fd, data + done, len - done);
+
+		if (n < 0 && errno == EINTR)
+			continue;
+		DIE(n < 0, "Failed to write the output");
+		done += n;
+	}
+}
+
+/******************************************************************************
+ * This function prepares the reading of a file descriptor.
+ *
+ * @param in - A pointer to the reader.
+ * @param fd - The file descriptor.
+ *****************************************************************************/
+void io_reader_init(io_reader_t *in, int fd)
+{
+	in->fd = fd;
+	in->cap = IO_BLOCK_SIZE;
+	in->data = malloc(in->cap);
+	DIE(!in->data, "Failed to allocate the input buffer");
+	in->start = 0;
+	in->end = 0;
+	in->eof = 0;
+	in->cursor = NULL;
+	in->line = NULL;
+	in->again = 0;
+	in->ring = NULL;
+}
+
+/*
+ * The block a reader thread fills, and the one that takes the rest of its
+ * last line while it waits for a slot of the ring. They stay in memory, not
+ * in registers, so the cleanup handler of a stopped thread frees them both.
+ */
+typedef struct io_block_t io_block_t;
+struct io_block_t {
+	char *data;
+	size_t len;
+	size_t cap;
+	char *next;
+};
+
+/******************************************************************************
+ * This function frees the block of a reader thread that is stopped.
+ *
+ * @param arg - A pointer to the block.
+ *****************************************************************************/
+static void io_free_block(void *arg)
+{
+	io_block_t *block = arg;
+
+	free(block->data);
+	free(block->next);
+}
+
+/******************************************************************************
+ * This function is run by the thread that reads the input of a pipeline. It
+ * passes on the input in blocks of whole lines, so the lines never have to
+ * be moved once they are in the ring.
+ *
+ * @param arg - A pointer to the reader.
+ *
+ * @return NULL
+ *****************************************************************************/
+static void *io_reader_run(void *arg)
+{
+	io_reader_t *in = arg;
+	io_block_t block = {NULL, 0, IO_BLOCK_SIZE, NULL};
+
+	block.data = malloc(block.cap);
+	DIE(!block.data, "Failed to allocate the input buffer");
+
+	// A reader stopped before the end of the input frees its block
+	pthread_cleanup_push(io_free_block, &block);
+	while (1) {
+		// One byte is kept for the '\n' of a last line without one
+		if (block.cap - block.len <= IO_BLOCK_SIZE / 2) {
+			block.cap *= 2;
+			block.data = realloc(block.data, block.cap);
+			DIE(!block.data, "Failed to grow the input buffer");
+		}
+
+		ssize_t n = read(in->fd, block.data + block.len,
+						 block.cap - block.len - 1);
+
+		if (n < 0 && errno == EINTR)
+			continue;
+		DIE(n < 0, "Failed to read the input");
+		if (n == 0) {
+			if (block.len > 0) {
+				block.data[block.len++] = '\n';
+				io_ring_push(in->ring, block.data, block.len);
+				block.data = NULL;
+			}
+			break;
+		}
+
+		// The incomplete last line starts the next block
+		size_t cut = block.len + n;
+
+		while (cut > block.len && block.data[cut - 1] != '\n')
+			cut--;
+		block.len += n;
+		if (cut == 0 || block.data[cut - 1] != '\n')
+			continue;
+
+		size_t rest = block.len - cut;
+		size_t next_cap = IO_BLOCK_SIZE;
+
+		while (rest + IO_BLOCK_SIZE / 2 >= next_cap)
+			next_cap *= 2;
+
+		block.next = malloc(next_cap);
+		DIE(!block.next, "Failed to allocate the input buffer");
+		memcpy(block.next, block.data + cut, rest);
+		io_ring_push(in->ring, block.data, cut);
+		block.data = block.next;
+		block.next = NULL;
+		block.cap = next_cap;
+		block.len = rest;
+	}
+	free(block.data);
+	block.data = NULL;
+	io_ring_push(in->ring, NULL, 0);
+	pthread_cleanup_pop(0);
+
+	return NULL;
+}
+
+/******************************************************************************
+ * This function moves the reading of the input to a thread of its own, which
+ * reads ahead while the lines already read are executed.
+ *
+ * @param in - A pointer to the reader, before any line is read.
+ *****************************************************************************/
+void io_reader_pipeline(io_reader_t *in)
+{
+	in->ring = io_ring_create();
+	DIE(pthread_create(&in->thread, NULL, io_reader_run, in),
+		"Failed to create the reader thread");
+}
+
+/******************************************************************************
+ * This function returns the next line of the input, without its '\n'. The
+ * buffer is only refilled when it holds no whole line, with one large read,
+ * or, with a pipeline, replaced by the next block of the reader thread.
+ *
+ * @param in - A pointer to the reader.
+ *
+ * @return line - The line, cut in place in the buffer, or NULL at the end of
+ *                the input. Its tokens are given by io_next_token.
+ *****************************************************************************/
+char *io_read_line(io_reader_t *in)
+{
+	// The line given back by io_unread_line comes first
+	if (in->again) {
+		in->again = 0;
+		in->cursor = in->line;
+		return in->line;
+	}
+
+	while (1) {
+		char *line = in->data + in->start;
+		char *newline = memchr(line, '\n', in->end - in->start);
+
+		if (newline) {
+			*newline = '\0';
+			in->start = newline + 1 - in->data;
+			in->cursor = line;
+			in->line = line;
+			return line;
+		}
+
+		// The last line may have no '\n'
+		if (in->eof) {
+			if (in->start == in->end)
+				return NULL;
+			in->data[in->end] = '\0';
+			in->start = in->end;
+			in->cursor = line;
+			in->line = line;
+			return line;
+		}
+
+		// The blocks of a pipeline only hold whole lines, so the current
+		// one is done
+		if (in->ring) {
+			size_t len;
+			char *block = io_ring_pop(in->ring, &len);
+
+			in->start = 0;
+			in->end = 0;
+			if (!block) {
+				in->eof = 1;
+				continue;
+			}
+			free(in->data);
+			in->data = block;
+			in->end = len;
+			in->cap = len;
+			continue;
+		}
+
+		// Move the incomplete line to the front, grow the buffer if the
+		// line fills it, and read the next block after it
+		memmove(in->data, line, in->end - in->start);
+		in->end -= in->start;
+		in->start = 0;
+		if (in->cap - in->end <= IO_BLOCK_SIZE / 2) {
+			in->cap *= 2;
+			in->data = realloc(in->data, in->cap);
+			DIE(!in->data, "Failed to grow the input buffer");
+		}
+
+		// One byte is kept for the '\0' of a last line without '\n'
+		ssize_t n = read(in->fd, in->data + in->end, in->cap - in->end - 1);
+
+		if (n < 0 && errno == EINTR)
+			continue;
+		DIE(n < 0, "Failed to read the input");
+		if (n == 0)
+			in->eof = 1;
+		in->end += n;
+	}
+}
+
+/******************************************************************************
+ * This function gives the current line back to the reader, so the next
+ * io_read_line returns it again. The line must not be split into tokens
+ * yet, and stays in place since no other line was read.
+ *
+ * @param in - A pointer to the reader.
+ *****************************************************************************/
+void io_unread_line(io_reader_t *in)
+{
+	in->again = 1;
+}
+
+/******************************************************************************
+ * This function returns the next token of the current line.
+ *
+ * @param in - A pointer to the reader.
+ *
+ * @return token - The token, cut in place in the line, or NULL if the line
+ *                 has no more tokens.
+ *****************************************************************************/
+char *io_next_token(io_reader_t *in)
+{
+	char *p = in->cursor;
+
+	if (!p)
+		return NULL;
+	while (isspace((unsigned char)*p))
+		p++;
+	if (*p == '\0') {
+		in->cursor = p;
+		return NULL;
+	}
+
+	char *token = p;
+
+	while (*p != '\0' && !isspace((unsigned char)*p))
+		p++;
+	if (*p != '\0')
+		*p++ = '\0';
+	in->cursor = p;
+
+	return token;
+}
+
+/******************************************************************************
+ * This function frees the buffer of a reader.
+ *
+ * @param in - A pointer to the reader.
+ *****************************************************************************/
+void io_reader_free(io_reader_t *in)
+{
+	// The thread may still wait for the input, or for a free slot
+	if (in->ring) {
+		if (!in->eof)
+			pthread_cancel(in->thread);
+		pthread_join(in->thread, NULL);
+		io_ring_free(in->ring);
+		in->ring = NULL;
+	}
+	free(in->data);
+	in->data = NULL;
+}
+
+/******************************************************************************
+ * This function prepares an output buffer.
+ *
+ * @param out - A pointer to the buffer.
+ * @param fd - The file descriptor the bytes are written to, or -1 to keep
+ *             them in the buffer.
+ *****************************************************************************/
+void io_buffer_init(io_buffer_t *out, int fd)
+{
+	out->fd = fd;
+	out->cap = IO_FLUSH_SIZE;
+	out->data = malloc(out->cap);
+	DIE(!out->data, "Failed to allocate the output buffer");
+	out->len = 0;
+	out->ring = NULL;
+}
+
+/******************************************************************************
+ * This function is run by the thread that writes the output of a pipeline.
+ *
+ * @param arg - A pointer to the buffer.
+ *
+ * @return NULL
+ *****************************************************************************/
+static void *io_buffer_run(void *arg)
+{
+	io_buffer_t *out = arg;
+	size_t len;
+	char *data;
+
+	while ((data = io_ring_pop(out->ring, &len))) {
+		io_write_fd(out->fd, data, len);
+		free(data);
+	}
+
+	return NULL;
+}
+
+/******************************************************************************
+ * This function moves the writing of an output buffer to a thread of its
+ * own: a full buffer is handed to it and a new one is filled meanwhile.
+ *
+ * @param out - A pointer to the buffer, with a file descriptor.
+ *****************************************************************************/
+void io_buffer_pipeline(io_buffer_t *out)
+{
+	out->ring = io_ring_create();
+	DIE(pthread_create(&out->thread, NULL, io_buffer_run, out),
+		"Failed to create the writer thread");
+}
+
+/******************************************************************************
+ * This function makes room for a number of bytes at the end of a buffer.
+ *
+ * @param out - A pointer to the buffer.
+ * @param len - The number of bytes.
+ *****************************************************************************/
+static void io_reserve(io_buffer_t *out, size_t len)
+{
+	if (out->len + len <= out->cap)
+		return;
+	while (out->len + len > out->cap)
+		out->cap *= 2;
+	out->data = realloc(out->data, out->cap);
+	DIE(!out->data, "Failed to grow the output buffer");
+}
+
+/******************************************************************************
+ * This function adds bytes to an output buffer. The output of a trie whose
+ * buffer is NULL goes straight to stdout.
+ *
+ * @param out - A pointer to the buffer, or NULL.
+ * @param data - The bytes.
+ * @param len - The number of bytes.
+ *****************************************************************************/
+void io_write(io_buffer_t *out, const char *data, size_t len)
+{
+	if (!out) {
+		fwrite(data, 1, len, stdout);
+		return;
+	}
+
+	io_reserve(out, len);
+	memcpy(out->data + out->len, data, len);
+	out->len += len;
+
+	if (out->fd >= 0 && out->len >= IO_FLUSH_SIZE)
+		io_flush(out);
+}
+
+/******************************************************************************
+ * This function adds a line to an output buffer.
+ *
+ * @param out - A pointer to the buffer, or NULL.
+ * @param data - The bytes of the line, without the '\n'.
+ * @param len - The number of bytes.
+ *****************************************************************************/
+void io_write_line(io_buffer_t *out, const char *data, size_t len)
+{
+	if (!out) {
+		fwrite(data, 1, len, stdout);
+		putchar('\n');
+		return;
+	}
+
+	io_reserve(out, len + 1);
+	memcpy(out->data + out->len, data, len);
+	out->data[out->len + len] = '\n';
+	out->len += len + 1;
+
+	if (out->fd >= 0 && out->len >= IO_FLUSH_SIZE)
+		io_flush(out);
+}
+
+/******************************************************************************
+ * This function adds formatted text to an output buffer, like printf.
+ *
+ * @param out - A pointer to the buffer, or NULL.
+ * @param format - The format of the text.
+ *****************************************************************************/
+void io_printf(io_buffer_t *out, const char *format, ...)
+{
+	va_list args;
+	int len;
+
+	va_start(args, format);
+	if (!out) {
+		vprintf(format, args);
+		va_end(args);
+		return;
+	}
+	len = vsnprintf(out->data + out->len, out->cap - out->len, format, args);
+	va_end(args);
+
+	// Format again once the text fits
+	if (out->len + len >= out->cap) {
+		io_reserve(out, len + 1);
+		va_start(args, format);
+		vsnprintf(out->data + out->len, out->cap - out->len, format, args);
+		va_end(args);
+	}
+	out->len += len;
+
+	if (out->fd >= 0 && out->len >= IO_FLUSH_SIZE)
+		io_flush(out);
+}
+
+/******************************************************************************
+ * This function writes the bytes of an output buffer to its file descriptor,
+ * or hands them to the writer thread of a pipeline.
+ *
+ * @param out - A pointer to the buffer.
+ *****************************************************************************/
+void io_flush(io_buffer_t *out)
+{
+	if (!out || out->fd < 0 || out->len == 0)
+		return;
+
+	if (!out->ring) {
+		io_write_fd(out->fd, out->data, out->len);
+		out->len = 0;
+		return;
+	}
+
+	// The writer thread owns the buffer from now on
+	io_ring_push(out->ring, out->data, out->len);
+	out->cap = IO_FLUSH_SIZE;
+	out->data = malloc(out->cap);
+	DIE(!out->data, "Failed to allocate the output buffer");
+	out->len = 0;
+}
+
+/******************************************************************************
+ * This function frees the memory of an output buffer, after writing it.
+ *
+ * @param out - A pointer to the buffer.
+ *****************************************************************************/
+void io_buffer_free(io_buffer_t *out)
+{
+	io_flush(out);
+	if (out->ring) {
+		io_ring_push(out->ring, NULL, 0);
+		pthread_join(out->thread, NULL);
+		io_ring_free(out->ring);
+		out->ring = NULL;
+	}
+	free(out->data);
+	out->data = NULL;
+}
@@ -0,0 +1,112 @@
+/* <Copyright Niculici Mihai-Daniel 2023 > */
+
+#ifndef IO_H_
+#define IO_H_
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <semaphore.h>
+
+#ifndef DIE
+#define DIE(assertion, call_description)				\
+	do {								\
+		if (assertion) {					\
+			fprintf(stderr, "(%s, %d): ",			\
+					__FILE__, __LINE__);		\
+			perror(call_description);			\
+			exit(errno);				        \
+		}							\
+	} while (0)
+#endif
+
+/* Number of bytes read from the input at once, at least */
+#define IO_BLOCK_SIZE 65536
+
+/* Number of buffered output bytes after which they are written */
+#define IO_FLUSH_SIZE 65536
+
+/* Number of blocks a stage of a pipeline may run ahead of the next one */
+#define IO_RING_SLOTS 8
+
+/*
+ * Blocks handed from one thread to another, in order. Only the producer moves
+ * tail and only the consumer moves head, and the two semaphores count the
+ * filled and the empty slots, so neither side ever takes a lock: a thread
+ * only sleeps when the ring is empty or full. A NULL block ends the stream.
+ */
+typedef struct io_ring_t io_ring_t;
+struct io_ring_t {
+	char *data[IO_RING_SLOTS];
+	size_t len[IO_RING_SLOTS];
+	unsigned int head;
+	unsigned int tail;
+	sem_t filled;
+	sem_t empty;
+};
+
+/*
+ * Input read in large blocks. The lines are cut in place in the buffer and
+ * the tokens of the current line are cut in place in the line, so they stay
+ * valid until the next line is read.
+ */
+typedef struct io_reader_t io_reader_t;
+struct io_reader_t {
+	int fd;
+	char *data;
+	size_t start;
+	size_t end;
+	size_t cap;
+	int eof;
+
+	/* The rest of the current line, not split into tokens yet */
+	char *cursor;
+
+	/* The current line, and whether the next read gives it again */
+	char *line;
+	int again;
+
+	/*
+	 * With a pipeline, the thread that reads the input and the blocks of
+	 * whole lines it read ahead, NULL otherwise
+	 */
+	io_ring_t *ring;
+	pthread_t thread;
+};
+
+/*
+ * Output collected in a growable buffer. With a file descriptor, the bytes
+ * are written once IO_FLUSH_SIZE of them are buffered; with fd -1 they stay
+ * in the buffer until the owner takes them.
+ */
+typedef struct io_buffer_t io_buffer_t;
+struct io_buffer_t {
+	int fd;
+	char *data;
+	size_t len;
+	size_t cap;
+
+	/* With a pipeline, the thread that writes the full buffers, or NULL */
+	io_ring_t *ring;
+	pthread_t thread;
+};
+
+void io_reader_init(io_reader_t *in, int fd);
+void io_reader_pipeline(io_reader_t *in);
+char *io_read_line(io_reader_t *in);
+void io_unread_line(io_reader_t *in);
+char *io_next_token(io_reader_t *in);
+void io_reader_free(io_reader_t *in);
+
+void io_buffer_init(io_buffer_t *out, int fd);
+void io_buffer_pipeline(io_buffer_t *out);
+void io_write(io_buffer_t *out, const char *data, size_t len);
+void io_write_line(io_buffer_t *out, const char *data, size_t len);
+void io_printf(io_buffer_t *out, const char *format, ...);
+void io_flush(io_buffer_t *out);
+void io_buffer_free(io_buffer_t *out);
+
+#endif /* IO_H_ */
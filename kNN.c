@@ -1,83 +1,177 @@
 /* <Copyright Niculici Mihai-Daniel 2023 > */
 
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
 #include <math.h>
+#include <unistd.h>
 #include "BST.h"
 
-int main(void)
+/******************************************************************************
+ * This function returns the next word of the input, like scanf("%s"), from
+ * the current line or from the next ones.
+ *
+ * @param in - A pointer to the reader.
+ *
+ * @return token - The word, or NULL at the end of the input.
+ *****************************************************************************/
+static char *next_token(io_reader_t *in)
+{
+	char *token;
+
+	while (!(token = io_next_token(in)))
+		if (!io_read_line(in))
+			return NULL;
+	return token;
+}
+
+/******************************************************************************
+ * This function returns the next number of the input, like scanf("%d").
+ *
+ * @param in - A pointer to the reader.
+ *
+ * @return number - The number, or 0 at the end of the input.
+ *****************************************************************************/
+static int next_int(io_reader_t *in)
+{
+	char *token = next_token(in);
+
+	return token ? atoi(token) : 0;
+}
+
+/******************************************************************************
+ * This function reads the point of an NN command and prints its nearest
+ * neighbors.
+ *
+ * @param tree - A pointer to the tree, with points loaded.
+ * @param in - A pointer to the reader.
+ * @param out - A pointer to the output buffer.
+ * @param k - The number of coordinates of the points.
+ *****************************************************************************/
+static void run_nn(b_tree_t *tree, io_reader_t *in, io_buffer_t *out, int k)
 {
-	// Allocate memory for the command
-	b_tree_t *tree;
-	char *command = malloc(MAX_STRING_SIZE * sizeof(char));
+	// Initialize the vector of coordinates
+	int *vector_of_coord = malloc(k * sizeof(int));
+	DIE(!vector_of_coord, "vector_of_coord malloc failed!\n");
+
+	// Initialize the result vector
+	int *result = malloc(3 * k * sizeof(int));
+	DIE(!result, "result malloc failed!\n");
+
+	// Initialize the minimum distance
+	int *min_distance = malloc(sizeof(int));
+	DIE(!min_distance, "min_distance malloc failed!\n");
+
+	*min_distance = INT_MAX;
+
+	int size = 0;
+
+	// Read the coordinates
+	for (int i = 0; i < k; i++)
+		vector_of_coord[i] = next_int(in);
+
+	// Find the nearest neighbors
+	NN(tree, tree->root, vector_of_coord, 0, k, &size, result,
+	   min_distance);
+	for (int i = 0; i < size; i++) {
+		for (int j = 0; j < k; j++)
+			io_printf(out, "%d ", result[i * k + j]);
+		io_write(out, "\n", 1);
+	}
+	// Free the memory
+	free(vector_of_coord);
+	free(result);
+	free(min_distance);
+}
+
+/******************************************************************************
+ * This function reads the intervals of an RS command and prints the points
+ * that are in them.
+ *
+ * @param tree - A pointer to the tree, with points loaded.
+ * @param in - A pointer to the reader.
+ * @param k - The number of coordinates of the points.
+ *****************************************************************************/
+static void run_rs(b_tree_t *tree, io_reader_t *in, int k)
+{
+	// Initialize the vector of coordinates
+	int *start = malloc(k * sizeof(int));
+	DIE(!start, "start malloc failed!\n");
+
+	int *end = malloc(k * sizeof(int));
+	DIE(!end, "end malloc failed!\n");
+
+	// Read the coordinates
+	for (int i = 0; i < k; i++) {
+		start[i] = next_int(in);
+		end[i] = next_int(in);
+	}
+
+	// Search the points in the given range
+	RS(tree, tree->root, k, start, end);
+
+	// Free the memory
+	free(start);
+	free(end);
+}
+
+int main(int argc, char *argv[])
+{
+	io_reader_t in;
+	io_buffer_t out;
+	b_tree_t *tree = NULL;
+	char *command;
 	int k;
-	while (1) {
-		// Read the command
-		scanf("%s", command);
+
+	if (argc > 2 || (argc == 2 && strcmp(argv[1], "--pipeline") != 0)) {
+		fprintf(stderr, "usage: %s [--pipeline]\n", argv[0]);
+		return 1;
+	}
+
+	// The commands are read in large blocks and the results are collected
+	// in a buffer that is written in large blocks
+	io_reader_init(&in, STDIN_FILENO);
+	io_buffer_init(&out, STDOUT_FILENO);
+
+	// With --pipeline, one thread reads the next commands and another one
+	// writes the last results while the tree executes
+	if (argc == 2) {
+		io_reader_pipeline(&in);
+		io_buffer_pipeline(&out);
+	}
+
+	// Read commands until EXIT or the end of the input
+	while ((command = next_token(&in)) && strcmp(command, "EXIT") != 0) {
 		// Which command is it?
 		if (strcmp(command, "LOAD") == 0) {
 			// Load the words from the file into the BST
-			tree = load(tree, &k);
+			char *filename = next_token(&in);
+
+			if (!filename)
+				break;
+			tree = load(tree, filename, &k);
+			tree->out = &out;
+		} else if (!tree && (strcmp(command, "NN") == 0 ||
+							 strcmp(command, "RS") == 0)) {
+			// No points are loaded yet, so the coordinates are skipped
+			while (io_next_token(&in))
+				;
 		} else if (strcmp(command, "NN") == 0) {
-			// Initialize the vector of coordinates
-			int *vector_of_coord = malloc(k * sizeof(int));
-			DIE(!vector_of_coord, "vector_of_coord malloc failed!\n");
-
-			// Initialize the result vector
-			int *result = malloc(3 * k * sizeof(int));
-			DIE(!result, "result malloc failed!\n");
-
-			// Initialize the minimum distance
-			int *min_distance = malloc(sizeof(int));
-			DIE(!min_distance, "min_distance malloc failed!\n");
-
-			*min_distance = INT_MAX;
-
-			int size = 0;
-
-			// Read the coordinates
-			for (int i = 0; i < k; i++)
-				scanf("%d", &vector_of_coord[i]);
-
-			// Find the nearest neighbors
-			NN(tree, tree->root, vector_of_coord, 0, k, &size, result,
-			   min_distance);
-			for (int i = 0; i < size; i++) {
-				for (int j = 0; j < k; j++)
-					printf("%d ", result[i * k + j]);
-				printf("\n");
-			}
-			// Free the memory
-			free(vector_of_coord);
-			free(result);
-			free(min_distance);
+			run_nn(tree, &in, &out, k);
 		} else if (strcmp(command, "RS") == 0) {
-			// Initialize the vector of coordinates
-			int *start = malloc(k * sizeof(int));
-			DIE(!start, "start malloc failed!\n");
-
-			int *end = malloc(k * sizeof(int));
-			DIE(!end, "end malloc failed!\n");
-
-			// Read the coordinates
-			for (int i = 0; i < k; i++)
-				scanf("%d %d", &start[i], &end[i]);
-
-			// Search the points in the given range
-			RS(tree, tree->root, k, start, end);
-
-			// Free the memory
-			free(start);
-			free(end);
-		} else if (strcmp(command, "EXIT") == 0) {
-			// Free the memory and exit
-			free(command);
-			EXIT(tree);
+			run_rs(tree, &in, k);
 		} else {
-			printf("Invalid command\n");
+			io_printf(&out, "Invalid command\n");
 		}
 	}
+
+	// Free the memory and exit, after writing the last results
+	io_buffer_free(&out);
+	io_reader_free(&in);
+	if (tree)
+		EXIT(tree);
 	return 0;
 }
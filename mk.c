@@ -1,67 +1,54 @@
 /* <Copyright Niculici Mihai-Daniel 2023 > */
 
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <unistd.h>
 #include "trie.h"
+#include "io.h"
+#include "cache.h"
+#include "command.h"
 
-int main(void)
+int main(int argc, char *argv[])
 {
-	// Allocate memory for the command
-	char *command = malloc(MAX_STRING_SIZE);
-	int k;
-	DIE(!command, "command malloc failed!\n");
+	io_reader_t in;
+	io_buffer_t out;
 
-	// Create the trie
-	trie_t *trie = trie_create(ALPHABET_SIZE, ALPHABET);
+	if (argc > 2 || (argc == 2 && strcmp(argv[1], "--pipeline") != 0)) {
+		fprintf(stderr, "usage: %s [--pipeline]\n", argv[0]);
+		return 1;
+	}
 
-	// Read commands
-	while (1) {
-		scanf("%s", command);
-		// Which command is it?
-		switch (which_command(command)) {
-		case INSERT:
-			// Read the word to be inserted
-			scanf("%s", command);
-			trie_insert(trie, command);
-			break;
+	// The commands are read in large blocks and the results are collected
+	// in a buffer that is written in large blocks
+	io_reader_init(&in, STDIN_FILENO);
+	io_buffer_init(&out, STDOUT_FILENO);
 
-		case LOAD:
-			// Load the words from the file into the trie
-			scanf("%s", command);
-			trie_load(trie, command);
-			break;
+	// With --pipeline, one thread reads the next commands and another one
+	// writes the last results while the trie executes
+	if (argc == 2) {
+		io_reader_pipeline(&in);
+		io_buffer_pipeline(&out);
+	}
 
-		case REMOVE:
-			// Remove the word from the trie
-			scanf("%s", command);
-			trie_remove(trie, command);
-			break;
+	// Create the trie
+	trie_t *trie = trie_create(ALPHABET_SIZE, ALPHABET);
+	trie->out = &out;
 
-		case AUTOCORRECT:
-			// Autocorrect the word
-			scanf("%s", command);
-			scanf("%d", &k);
-			trie_autocorrect(trie, command, k);
-			break;
+	// The same prefixes and misspellings come again and again
+	trie->cache = cache_create(CACHE_DEFAULT_ENTRIES);
 
-		case AUTOCOMPLETE:
-			// Autocomplete the word
-			scanf("%s", command);
-			scanf("%d", &k);
-			trie_autocomplete(trie, command, k);
+	// Read commands, one on every line, until EXIT or the end of the input
+	while (io_read_line(&in))
+		if (command_execute(trie, &in) == EXIT)
 			break;
 
-		case EXIT:
-			// Free the memory and exit
-			trie_free(&trie);
-			free(command);
-			return 0;
-
-		default:
-			// Wrong command
-			continue;
-		}
-	}
+	// Free the memory, after writing the last results
+	trie_free(&trie);
+	io_buffer_free(&out);
+	io_reader_free(&in);
+	return 0;
 }
@@ -0,0 +1,256 @@
+/* <Copyright Niculici Mihai-Daniel 2023 > */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <ctype.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "snapshot.h"
+
+/******************************************************************************
+ * This function rounds an offset of the file up to the alignment of the
+ * sections.
+ *
+ * @param offset - The offset.
+ *
+ * @return offset - The first aligned offset, not before the given one.
+ *****************************************************************************/
+static u64 snapshot_align(u64 offset)
+{
+	return (offset + SNAPSHOT_ALIGN - 1) / SNAPSHOT_ALIGN * SNAPSHOT_ALIGN;
+}
+
+/******************************************************************************
+ * This function writes a section of the file at its offset, padding the
+ * space before it with zeros.
+ *
+ * @param file - The file.
+ * @param pos - A pointer to the number of bytes written so far.
+ * @param offset - The offset of the section.
+ * @param data - The bytes of the section.
+ * @param bytes - The size of the section.
+ *****************************************************************************/
+static void snapshot_section(FILE *file, u64 *pos, u64 offset,
+							 const void *data, size_t bytes)
+{
+	for (; *pos < offset; (*pos)++)
+		DIE(fputc(0, file) == EOF, "Failed to write the snapshot");
+
+	DIE(fwrite(data, 1, bytes, file) != bytes, "Failed to write the snapshot");
+	*pos += bytes;
+}
+
+/******************************************************************************
+ * This function saves the trie, with its frequencies, to a snapshot file
+ * that OPEN can map back. The file is written next to the old one and then
+ * renamed over it, so a snapshot that is still mapped is never truncated.
+ *
+ * @param trie - A pointer to the trie data structure.
+ * @param filename - The name of the snapshot file.
+ *****************************************************************************/
+void snapshot_save(trie_t *trie, char *filename)
+{
+	char tmp[MAX_STRING_SIZE + 8];
+	snapshot_header_t header;
+	u64 pos = 0;
+
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+	header.version = SNAPSHOT_VERSION;
+	header.node_size = sizeof(trie_node_t);
+	header.alphabet_size = trie->alphabet_size;
+	memcpy(header.alphabet, trie->alphabet, sizeof(header.alphabet));
+	header.root = trie->root;
+	header.nodes_used = trie->nodes_used;
+	header.free_list = trie->free_list;
+	header.kids_used = trie->kids_used;
+	memcpy(header.kids_free, trie->kids_free, sizeof(header.kids_free));
+	header.size = trie->size;
+	header.nwords = trie->nwords;
+	header.nnodes = trie->nnodes;
+	header.frozen = trie->frozen;
+
+	// The sections follow the header, in this order
+	header.nodes_offset = snapshot_align(sizeof(header));
+	header.kids_offset = snapshot_align(header.nodes_offset +
+		(u64)trie->nodes_used * sizeof(trie_node_t));
+	header.file_size = header.kids_offset +
+		(u64)trie->kids_used * sizeof(u32);
+	if (trie->frozen) {
+		header.freqs_offset = snapshot_align(header.file_size);
+		header.freq_max_offset = snapshot_align(header.freqs_offset +
+			(u64)trie->nwords * sizeof(int));
+		header.file_size = header.freq_max_offset +
+			(2 * (u64)trie->nwords + 1) * sizeof(u32);
+	}
+
+	snprintf(tmp, sizeof(tmp), "%s.tmp", filename);
+	FILE *file = fopen(tmp, "wb");
+	DIE(!file, "Failed to create the snapshot");
+
+	snapshot_section(file, &pos, 0, &header, sizeof(header));
+	snapshot_section(file, &pos, header.nodes_offset, trie->nodes,
+					 trie->nodes_used * sizeof(trie_node_t));
+	snapshot_section(file, &pos, header.kids_offset, trie->kids,
+					 trie->kids_used * sizeof(u32));
+	if (trie->frozen) {
+		snapshot_section(file, &pos, header.freqs_offset, trie->freqs,
+						 trie->nwords * sizeof(int));
+		snapshot_section(file, &pos, header.freq_max_offset, trie->freq_max,
+						 (2 * trie->nwords + 1) * sizeof(u32));
+	}
+
+	DIE(fclose(file) != 0, "Failed to write the snapshot");
+	DIE(rename(tmp, filename) != 0, "Failed to rename the snapshot");
+}
+
+/******************************************************************************
+ * This function checks that the header of a mapped file describes a
+ * snapshot of this build of the trie, whose sections fit in the file and
+ * whose arena links (root, free lists) point inside the arenas. The links
+ * inside the nodes and the child blocks are trusted: checking them would
+ * read the whole file, which OPEN avoids, so a snapshot must come from SAVE.
+ *
+ * @param header - The header of the file.
+ * @param size - The size of the file.
+ *
+ * @return result - 1 if the snapshot can be used, 0 otherwise.
+ *****************************************************************************/
+static int snapshot_valid(snapshot_header_t *header, u64 size)
+{
+	if (memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(header->magic)) != 0 ||
+		header->version != SNAPSHOT_VERSION ||
+		header->node_size != sizeof(trie_node_t) ||
+		header->file_size != size)
+		return 0;
+
+	// The alphabet is kept sorted, without separators
+	if (header->alphabet_size == 0 ||
+		header->alphabet_size > TRIE_MAX_ALPHABET ||
+		header->alphabet[header->alphabet_size] != '\0')
+		return 0;
+	for (u32 i = 0; i < header->alphabet_size; i++) {
+		unsigned char c = header->alphabet[i];
+
+		if (c == '\0' || isspace(c) ||
+			(i > 0 && c <= (unsigned char)header->alphabet[i - 1]))
+			return 0;
+	}
+
+	// The root and the sentinel always exist
+	if (header->nodes_used <= TRIE_NIL + 1 || header->root == TRIE_NIL ||
+		header->root >= header->nodes_used || header->kids_used == 0 ||
+		header->free_list >= header->nodes_used)
+		return 0;
+	for (int i = 0; i < TRIE_NODE_KINDS; i++)
+		if (header->kids_free[i] >= header->kids_used)
+			return 0;
+
+	if (header->nodes_offset % SNAPSHOT_ALIGN != 0 ||
+		header->kids_offset % SNAPSHOT_ALIGN != 0 ||
+		header->nodes_offset + (u64)header->nodes_used *
+		sizeof(trie_node_t) > header->kids_offset ||
+		header->kids_offset + (u64)header->kids_used *
+		sizeof(u32) > size)
+		return 0;
+
+	if (header->frozen &&
+		(header->nwords < 0 ||
+		 header->freqs_offset % SNAPSHOT_ALIGN != 0 ||
+		 header->freq_max_offset % SNAPSHOT_ALIGN != 0 ||
+		 header->freqs_offset + (u64)header->nwords * sizeof(int) >
+		 header->freq_max_offset ||
+		 header->freq_max_offset + (2 * (u64)header->nwords + 1) *
+		 sizeof(u32) > size))
+		return 0;
+
+	return 1;
+}
+
+/******************************************************************************
+ * This function replaces the words of the trie with the ones of a snapshot
+ * written by SAVE. The file is mapped read-only and the queries run straight
+ * on the mapping: nothing is allocated or read in advance, the pages are
+ * loaded by the system when a query first touches them. The first change of
+ * the trie copies the arenas out of the mapping (see trie_make_writable).
+ *
+ * @param trie - A pointer to the trie data structure.
+ * @param filename - The name of the snapshot file.
+ *
+ * @return result - 0 if the snapshot was opened, -1 if the file cannot be
+ *                  read, is not a valid snapshot or if the trie is in the
+ *                  concurrent mode, in which case the trie is not changed.
+ *****************************************************************************/
+int snapshot_open(trie_t *trie, char *filename)
+{
+	struct stat info;
+
+	// The readers of the concurrent mode still use the current arenas
+	if (trie->concurrent)
+		return -1;
+
+	// Open the file
+	int fd = open(filename, O_RDONLY);
+
+	if (fd < 0)
+		return -1;
+	if (fstat(fd, &info) < 0 ||
+		(size_t)info.st_size < sizeof(snapshot_header_t)) {
+		close(fd);
+		return -1;
+	}
+
+	// Map the whole file
+	char *map = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+	close(fd);
+	if (map == MAP_FAILED)
+		return -1;
+
+	snapshot_header_t *header = (snapshot_header_t *)map;
+
+	if (!snapshot_valid(header, info.st_size)) {
+		munmap(map, info.st_size);
+		return -1;
+	}
+
+	// The trie takes the alphabet and the sections of the mapping
+	trie_release_arenas(trie);
+	trie_set_alphabet(trie, header->alphabet, header->alphabet_size);
+	trie->image = map;
+	trie->image_size = info.st_size;
+	trie->root = header->root;
+	trie->nodes = (trie_node_t *)(map + header->nodes_offset);
+	trie->nodes_used = header->nodes_used;
+	trie->nodes_cap = header->nodes_used;
+	trie->free_list = header->free_list;
+	trie->kids = (u32 *)(map + header->kids_offset);
+	trie->kids_used = header->kids_used;
+	trie->kids_cap = header->kids_used;
+	memcpy(trie->kids_free, header->kids_free, sizeof(trie->kids_free));
+	trie->size = header->size;
+	trie->nwords = header->nwords;
+	trie->nnodes = header->nnodes;
+
+	// The empty branches of a saved trie are not counted again, they stay
+	// until a COMPACT
+	trie->dead_nodes = 0;
+	trie->frozen = header->frozen;
+	if (trie->frozen) {
+		trie->freqs = (int *)(map + header->freqs_offset);
+		trie->freq_max = (u32 *)(map + header->freq_max_offset);
+	}
+
+	// The delete-variant index is rebuilt for the new words, the word store
+	// by its next scan
+	if (trie->symspell) {
+		symspell_free(&trie->symspell);
+		trie_set_option(trie, "engine", "symspell");
+	}
+	if (trie->wordstore)
+		wordstore_free(&trie->wordstore);
+
+	return 0;
+}
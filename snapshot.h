@@ -0,0 +1,56 @@
+/* <Copyright Niculici Mihai-Daniel 2023 > */
+
+#ifndef SNAPSHOT_H_
+#define SNAPSHOT_H_
+
+#include "trie.h"
+
+/* First bytes of every snapshot file */
+#define SNAPSHOT_MAGIC "MKTRIE\0"
+
+/* Version of the format, changed with the layout of the nodes */
+#define SNAPSHOT_VERSION 2
+
+/* Alignment of the sections of the file */
+#define SNAPSHOT_ALIGN 64
+
+/*
+ * Header of a snapshot. The arenas follow it, each at the offset given here,
+ * and every link between the nodes is an index in the arenas, so the file
+ * can be used from any address it is mapped at.
+ */
+typedef struct snapshot_header_t snapshot_header_t;
+struct snapshot_header_t {
+	char magic[8];
+	u32 version;
+	u32 node_size;
+	u32 alphabet_size;
+
+	/* The sorted symbols of the alphabet, that the letters index */
+	char alphabet[TRIE_MAX_ALPHABET + 1];
+
+	/* The fields of trie_t that describe the arenas */
+	u32 root;
+	u32 nodes_used;
+	u32 free_list;
+	u32 kids_used;
+	u32 kids_free[TRIE_NODE_KINDS];
+
+	/* The counters of the trie */
+	s32 size;
+	s32 nwords;
+	s32 nnodes;
+	s32 frozen;
+
+	/* Offsets of the sections, the last two only in a frozen snapshot */
+	u64 nodes_offset;
+	u64 kids_offset;
+	u64 freqs_offset;
+	u64 freq_max_offset;
+	u64 file_size;
+};
+
+void snapshot_save(trie_t *trie, char *filename);
+int snapshot_open(trie_t *trie, char *filename);
+
+#endif /* SNAPSHOT_H_ */
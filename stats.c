@@ -0,0 +1,176 @@
+/* <Copyright Niculici Mihai-Daniel 2023 > */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <time.h>
+#include "trie.h"
+#include "stats.h"
+
+/* The commands that have a latency histogram, in the order of the report */
+static const struct {
+	const char *name;
+	int code;
+} stats_commands[STATS_COMMANDS] = {
+	{"INSERT", INSERT}, {"REMOVE", REMOVE}, {"LOAD", LOAD},
+	{"LOADFREQ", LOADFREQ}, {"AUTOCOMPLETE", AUTOCOMPLETE},
+	{"AUTOCORRECT", AUTOCORRECT}, {"BATCH", BATCH}, {"FREEZE", FREEZE},
+	{"SAVE", SAVE}, {"OPEN", OPEN}, {"SET", SET}, {"MEMORY", MEMORY},
+	{"CACHE", CACHE}, {"STATS", STATS}, {"COMPACT", COMPACT}
+};
+
+/******************************************************************************
+ * This function returns the time of a monotonic clock, in seconds.
+ *
+ * @return seconds - The time.
+ *****************************************************************************/
+double stats_now(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/******************************************************************************
+ * This function adds the latency of a command to the histogram of its kind.
+ *
+ * @param stats - A pointer to the counters.
+ * @param code - The code of the command, see which_command.
+ * @param seconds - The time the command took.
+ *****************************************************************************/
+void stats_record(trie_stats_t *stats, int code, double seconds)
+{
+	unsigned long ns = seconds * 1e9;
+	int bucket = 0;
+
+	while (ns > 1 && bucket < STATS_BUCKETS - 1) {
+		ns >>= 1;
+		bucket++;
+	}
+
+	for (int i = 0; i < STATS_COMMANDS && stats_commands[i].name; i++)
+		if (stats_commands[i].code == code)
+			stats->latency[i][bucket]++;
+}
+
+#ifdef TRIE_STATS
+/******************************************************************************
+ * This function prints a duration of 2^bucket nanoseconds, in the unit that
+ * fits it.
+ *
+ * @param out - The buffer of the output, or NULL for stdout.
+ * @param bucket - The bucket of the duration.
+ *****************************************************************************/
+static void stats_print_duration(io_buffer_t *out, int bucket)
+{
+	static const char * const units[] = {"ns", "us", "ms", "s"};
+	unsigned long long ns = 1ULL << bucket;
+	int unit = 0;
+
+	while (unit < 3 && ns >= 1000) {
+		ns /= 1000;
+		unit++;
+	}
+	io_printf(out, " %llu%s:", ns, units[unit]);
+}
+
+/******************************************************************************
+ * This function prints the average of a counter over a number of queries.
+ *
+ * @param out - The buffer of the output, or NULL for stdout.
+ * @param name - The name of the average.
+ * @param total - The counter.
+ * @param queries - The number of queries.
+ *****************************************************************************/
+static void stats_print_mean(io_buffer_t *out, const char *name,
+							 unsigned long total, unsigned long queries)
+{
+	io_printf(out, ", %s/query: %.1f", name,
+			  queries ? (double)total / queries : 0.0);
+}
+#endif /* TRIE_STATS */
+
+/******************************************************************************
+ * This function prints the statistics of a trie: its size, then, if the
+ * counters are compiled in, the nodes read by every kind of query, the bytes
+ * allocated and the latency histogram of every kind of command. A bucket of
+ * a histogram is printed as "<lower bound>:<commands>".
+ *
+ * @param trie - A pointer to the trie data structure.
+ *****************************************************************************/
+void stats_report(trie_t *trie)
+{
+	io_buffer_t *out = trie->out;
+
+	io_printf(out, "size: %d, words: %d, nodes: %d\n", trie->size,
+			  trie->nwords, trie->nnodes);
+
+#ifdef TRIE_STATS
+	trie_stats_t *stats = &trie->stats;
+
+	for (int k = 0; k < 4; k++) {
+		if (stats->autocomplete[k] == 0)
+			continue;
+		io_printf(out, "AUTOCOMPLETE %d queries: %lu", k,
+				  stats->autocomplete[k]);
+		stats_print_mean(out, "nodes", stats->autocomplete_nodes[k],
+						 stats->autocomplete[k]);
+		stats_print_mean(out, "letters", stats->autocomplete_letters[k],
+						 stats->autocomplete[k]);
+		io_printf(out, "\n");
+	}
+	if (stats->top) {
+		io_printf(out, "AUTOCOMPLETE TOP queries: %lu", stats->top);
+		stats_print_mean(out, "nodes", stats->top_nodes, stats->top);
+		stats_print_mean(out, "heap entries", stats->top_entries,
+						 stats->top);
+		io_printf(out, "\n");
+	}
+	if (stats->fuzzy) {
+		io_printf(out, "AUTOCOMPLETE FUZZY queries: %lu", stats->fuzzy);
+		stats_print_mean(out, "nodes", stats->fuzzy_nodes, stats->fuzzy);
+		io_printf(out, "\n");
+	}
+	if (stats->autocorrect) {
+		io_printf(out, "AUTOCORRECT queries: %lu", stats->autocorrect);
+		stats_print_mean(out, "nodes", stats->autocorrect_nodes,
+						 stats->autocorrect);
+		io_printf(out, "\n");
+	}
+	if (stats->scan) {
+		io_printf(out, "AUTOCORRECT SCAN queries: %lu", stats->scan);
+		stats_print_mean(out, "words", stats->scan_words, stats->scan);
+		io_printf(out, "\n");
+	}
+	if (stats->edit) {
+		io_printf(out, "AUTOCORRECT EDIT queries: %lu", stats->edit);
+		stats_print_mean(out, "nodes", stats->edit_nodes, stats->edit);
+		io_printf(out, "\n");
+	}
+	if (stats->batch) {
+		io_printf(out, "BATCH queries: %lu", stats->batch);
+		stats_print_mean(out, "nodes", stats->batch_nodes, stats->batch);
+		io_printf(out, "\n");
+	}
+	io_printf(out, "nodes read: %lu, bytes allocated: %lu\n", stats->nodes,
+			  stats->bytes);
+
+	// One line for every kind of command that ran, with its buckets
+	for (int i = 0; i < STATS_COMMANDS && stats_commands[i].name; i++) {
+		int printed = 0;
+
+		for (int b = 0; b < STATS_BUCKETS; b++) {
+			if (stats->latency[i][b] == 0)
+				continue;
+			if (!printed++)
+				io_printf(out, "%s latency:", stats_commands[i].name);
+			stats_print_duration(out, b);
+			io_printf(out, "%lu", stats->latency[i][b]);
+		}
+		if (printed)
+			io_printf(out, "\n");
+	}
+#else
+	io_printf(out, "counters not compiled in, build with -DTRIE_STATS\n");
+#endif
+}
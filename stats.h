@@ -0,0 +1,106 @@
+/* <Copyright Niculici Mihai-Daniel 2023 > */
+
+#ifndef STATS_H_
+#define STATS_H_
+
+#include "io.h"
+
+/*
+ * Number of buckets of the latency histograms: bucket i counts the commands
+ * that took from 2^i to 2^(i+1) nanoseconds
+ */
+#define STATS_BUCKETS 40
+
+/* Most kinds of commands that have a latency histogram */
+#define STATS_COMMANDS 16
+
+/*
+ * Counters of the work of the queries, reported by STATS. They are only
+ * compiled in with -DTRIE_STATS ("make STATS=1"): otherwise the macros below
+ * expand to nothing and the trie has no counters at all.
+ */
+typedef struct trie_stats_t trie_stats_t;
+struct trie_stats_t {
+	/*
+	 * Nodes read by the walks (children looked up or listed), and letters
+	 * written by the completions of AUTOCOMPLETE
+	 */
+	unsigned long nodes;
+	unsigned long letters;
+
+	/* Queries, nodes and letters of AUTOCOMPLETE, by task */
+	unsigned long autocomplete[4];
+	unsigned long autocomplete_nodes[4];
+	unsigned long autocomplete_letters[4];
+
+	/* AUTOCOMPLETE TOP, with the entries pushed on its heap */
+	unsigned long top;
+	unsigned long top_nodes;
+	unsigned long top_entries;
+
+	/* AUTOCOMPLETE FUZZY, with the nodes of its Levenshtein walk */
+	unsigned long fuzzy;
+	unsigned long fuzzy_nodes;
+
+	/* AUTOCORRECT by Hamming and by edit distance */
+	unsigned long autocorrect;
+	unsigned long autocorrect_nodes;
+
+	/* The AUTOCORRECT answered by the word store, with the words compared */
+	unsigned long scan;
+	unsigned long scan_words;
+	unsigned long edit;
+	unsigned long edit_nodes;
+
+	/* Queries of the BATCH commands */
+	unsigned long batch;
+	unsigned long batch_nodes;
+
+	/* Bytes allocated by the arenas and by the queries */
+	unsigned long bytes;
+
+	/* Latency of the commands, by kind, see stats_record */
+	unsigned long latency[STATS_COMMANDS][STATS_BUCKETS];
+};
+
+#ifdef TRIE_STATS
+
+#define STATS_ADD(trie, counter, n) (((trie)->stats.counter) += (n))
+
+/*
+ * What a total counts between STATS_START and STATS_STOP goes to a counter.
+ * The trie is only read once, into a pointer to its counters.
+ */
+#define STATS_START(trie, counter, total) \
+	do { \
+		trie_stats_t *stats_ = &(trie)->stats; \
+		((*stats_).counter) -= (*stats_).total; \
+	} while (0)
+#define STATS_STOP(trie, counter, total) \
+	do { \
+		trie_stats_t *stats_ = &(trie)->stats; \
+		((*stats_).counter) += (*stats_).total; \
+	} while (0)
+
+/* The latency of a command, from STATS_CLOCK to STATS_COMMAND */
+#define STATS_CLOCK(start) double start = stats_now()
+#define STATS_COMMAND(trie, code, start) \
+	stats_record(&(trie)->stats, code, stats_now() - (start))
+
+#else
+
+#define STATS_ADD(trie, counter, n) ((void)0)
+#define STATS_START(trie, counter, total) ((void)0)
+#define STATS_STOP(trie, counter, total) ((void)0)
+#define STATS_CLOCK(start) ((void)0)
+#define STATS_COMMAND(trie, code, start) ((void)0)
+
+#endif /* TRIE_STATS */
+
+struct trie_t;
+
+double stats_now(void);
+void stats_record(trie_stats_t *stats, int code, double seconds);
+void stats_report(struct trie_t *trie);
+
+#endif /* STATS_H_ */
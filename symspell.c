@@ -0,0 +1,449 @@
+/* <Copyright Niculici Mihai-Daniel 2023 > */
+
+#include "symspell.h"
+
+/*
+ * AUTOCORRECT compares words of the same length letter by letter, so the
+ * delete variants keep the positions of the deleted letters: the variant of
+ * "whale" without its second and fourth letters is "w.a.e". Two words are at
+ * a distance of at most d if and only if they share a variant with d letters
+ * deleted (those where they differ, plus any others).
+ */
+
+/******************************************************************************
+ * This function computes the hash of a delete variant of a word.
+ *
+ * @param word - The word.
+ * @param len - The length of the word.
+ * @param pos - The sorted positions of the deleted letters.
+ * @param d - The number of deleted letters.
+ *
+ * @return hash - The 64-bit FNV-1a hash of the variant, never SYMSPELL_EMPTY.
+ *****************************************************************************/
+static u64 symspell_hash(char *word, int len, int *pos, int d)
+{
+	u64 hash = 14695981039346656037ULL ^ (u64)len;
+	int next = 0;
+
+	for (int i = 0; i < len; i++) {
+		unsigned char c = word[i];
+
+		// A deleted letter is hashed as a 0 byte, which is never a letter
+		if (next < d && pos[next] == i) {
+			c = 0;
+			next++;
+		}
+		hash = (hash ^ c) * 1099511628211ULL;
+	}
+
+	return hash == SYMSPELL_EMPTY ? 1 : hash;
+}
+
+/******************************************************************************
+ * This function moves to the next set of d positions out of len, in
+ * lexicographic order.
+ *
+ * @param pos - The sorted positions, updated in place.
+ * @param d - The number of positions.
+ * @param len - The number of letters.
+ *
+ * @return result - 1 if there is a next set, 0 after the last one.
+ *****************************************************************************/
+static int symspell_next_positions(int *pos, int d, int len)
+{
+	int i = d - 1;
+
+	// Find the last position that can still move to the right
+	while (i >= 0 && pos[i] == len - d + i)
+		i--;
+	if (i < 0)
+		return 0;
+
+	pos[i]++;
+	for (int j = i + 1; j < d; j++)
+		pos[j] = pos[j - 1] + 1;
+
+	return 1;
+}
+
+/******************************************************************************
+ * This function finds the slot of a variant in the hash table.
+ *
+ * @param index - A pointer to the index.
+ * @param hash - The hash of the variant.
+ *
+ * @return slot - The slot of the variant, or the empty slot where it belongs.
+ *****************************************************************************/
+static symspell_slot_t *symspell_find(symspell_t *index, u64 hash)
+{
+	u32 i = hash & (index->nslots - 1);
+
+	// Linear probing until the variant or an empty slot is found
+	while (index->slots[i].hash != SYMSPELL_EMPTY &&
+		   index->slots[i].hash != hash)
+		i = (i + 1) & (index->nslots - 1);
+
+	return &index->slots[i];
+}
+
+/******************************************************************************
+ * This function doubles the hash table and moves all the variants into it.
+ *
+ * @param index - A pointer to the index.
+ *****************************************************************************/
+static void symspell_grow(symspell_t *index)
+{
+	symspell_slot_t *old = index->slots;
+	u32 nold = index->nslots;
+
+	index->nslots *= 2;
+	index->slots = calloc(index->nslots, sizeof(symspell_slot_t));
+	DIE(!index->slots, "Failed to grow the symspell hash table");
+
+	for (u32 i = 0; i < nold; i++)
+		if (old[i].hash != SYMSPELL_EMPTY)
+			*symspell_find(index, old[i].hash) = old[i];
+
+	free(old);
+}
+
+/******************************************************************************
+ * This function creates an empty delete-variant index.
+ *
+ * @return index - A pointer to the index created.
+ *****************************************************************************/
+symspell_t *symspell_create(void)
+{
+	symspell_t *index = malloc(sizeof(symspell_t));
+	DIE(!index, "Failed to allocate memory for the symspell index");
+
+	index->nslots = SYMSPELL_INITIAL_SLOTS;
+	index->used_slots = 0;
+	index->slots = calloc(index->nslots, sizeof(symspell_slot_t));
+	DIE(!index->slots, "Failed to allocate memory for the symspell table");
+
+	index->npostings = 0;
+	index->postings_cap = SYMSPELL_INITIAL_SLOTS;
+	index->postings_free = SYMSPELL_NIL;
+	index->postings = malloc(index->postings_cap *
+							 sizeof(symspell_posting_t));
+	DIE(!index->postings, "Failed to allocate memory for the postings");
+
+	index->nwords = 0;
+	index->words_cap = SYMSPELL_INITIAL_SLOTS;
+	index->nfree = 0;
+	index->words = malloc(index->words_cap * sizeof(char *));
+	DIE(!index->words, "Failed to allocate memory for the symspell words");
+	index->free_ids = malloc(index->words_cap * sizeof(u32));
+	DIE(!index->free_ids, "Failed to allocate memory for the free ids");
+
+	return index;
+}
+
+/******************************************************************************
+ * This function adds a posting of a word to a variant.
+ *
+ * @param index - A pointer to the index.
+ * @param hash - The hash of the variant.
+ * @param id - The id of the word.
+ *****************************************************************************/
+static void symspell_link(symspell_t *index, u64 hash, u32 id)
+{
+	symspell_slot_t *slot;
+	u32 posting;
+
+	// Keep the hash table at most half full
+	if (2 * (index->used_slots + 1) > index->nslots)
+		symspell_grow(index);
+
+	slot = symspell_find(index, hash);
+	if (slot->hash == SYMSPELL_EMPTY) {
+		slot->hash = hash;
+		slot->head = SYMSPELL_NIL;
+		index->used_slots++;
+	}
+
+	// Take a released posting or a new one
+	if (index->postings_free != SYMSPELL_NIL) {
+		posting = index->postings_free;
+		index->postings_free = index->postings[posting].next;
+	} else {
+		if (index->npostings == index->postings_cap) {
+			index->postings_cap *= 2;
+			index->postings = realloc(index->postings, index->postings_cap *
+									  sizeof(symspell_posting_t));
+			DIE(!index->postings, "Failed to grow the symspell postings");
+		}
+		posting = index->npostings++;
+	}
+
+	index->postings[posting].word = id;
+	index->postings[posting].next = slot->head;
+	slot->head = posting;
+}
+
+/******************************************************************************
+ * This function removes the posting of a word from a variant.
+ *
+ * @param index - A pointer to the index.
+ * @param hash - The hash of the variant.
+ * @param id - The id of the word.
+ *****************************************************************************/
+static void symspell_unlink(symspell_t *index, u64 hash, u32 id)
+{
+	symspell_slot_t *slot = symspell_find(index, hash);
+	u32 *link = &slot->head;
+
+	if (slot->hash == SYMSPELL_EMPTY)
+		return;
+
+	while (*link != SYMSPELL_NIL && index->postings[*link].word != id)
+		link = &index->postings[*link].next;
+	if (*link == SYMSPELL_NIL)
+		return;
+
+	// Give the posting back to the free list
+	u32 posting = *link;
+
+	*link = index->postings[posting].next;
+	index->postings[posting].next = index->postings_free;
+	index->postings_free = posting;
+}
+
+/******************************************************************************
+ * This function adds or removes the postings of a word for all its variants
+ * with at most SYMSPELL_MAX_DISTANCE deleted letters.
+ *
+ * @param index - A pointer to the index.
+ * @param word - The word.
+ * @param len - The length of the word.
+ * @param id - The id of the word.
+ * @param add - 1 to add the postings, 0 to remove them.
+ *****************************************************************************/
+static void symspell_update(symspell_t *index, char *word, int len,
+							u32 id, int add)
+{
+	int pos[SYMSPELL_MAX_DISTANCE];
+
+	for (int d = 0; d <= SYMSPELL_MAX_DISTANCE && d <= len; d++) {
+		for (int i = 0; i < d; i++)
+			pos[i] = i;
+
+		do {
+			u64 hash = symspell_hash(word, len, pos, d);
+
+			if (add)
+				symspell_link(index, hash, id);
+			else
+				symspell_unlink(index, hash, id);
+		} while (symspell_next_positions(pos, d, len));
+	}
+}
+
+/******************************************************************************
+ * This function adds a word to the index. It is called when the word appears
+ * in the trie, so the word is not in the index yet.
+ *
+ * @param index - A pointer to the index.
+ * @param word - The word, not necessarily terminated by '\0'.
+ * @param len - The length of the word.
+ *****************************************************************************/
+void symspell_add(symspell_t *index, char *word, int len)
+{
+	u32 id;
+
+	// Reuse a released id or take a new one
+	if (index->nfree > 0) {
+		id = index->free_ids[--index->nfree];
+	} else {
+		if (index->nwords == index->words_cap) {
+			index->words_cap *= 2;
+			index->words = realloc(index->words,
+								   index->words_cap * sizeof(char *));
+			DIE(!index->words, "Failed to grow the symspell words");
+			index->free_ids = realloc(index->free_ids,
+									  index->words_cap * sizeof(u32));
+			DIE(!index->free_ids, "Failed to grow the free ids");
+		}
+		id = index->nwords++;
+	}
+
+	index->words[id] = malloc(len + 1);
+	DIE(!index->words[id], "Failed to allocate memory for a symspell word");
+	memcpy(index->words[id], word, len);
+	index->words[id][len] = '\0';
+
+	symspell_update(index, word, len, id, 1);
+}
+
+/******************************************************************************
+ * This function removes a word from the index.
+ *
+ * @param index - A pointer to the index.
+ * @param word - The word, not necessarily terminated by '\0'.
+ * @param len - The length of the word.
+ *****************************************************************************/
+void symspell_remove(symspell_t *index, char *word, int len)
+{
+	symspell_slot_t *slot = symspell_find(index, symspell_hash(word, len,
+																NULL, 0));
+
+	if (slot->hash == SYMSPELL_EMPTY)
+		return;
+
+	// The variant without deletions leads to the id of the word
+	for (u32 p = slot->head; p != SYMSPELL_NIL;
+		 p = index->postings[p].next) {
+		u32 id = index->postings[p].word;
+
+		if (strncmp(index->words[id], word, len) != 0 ||
+			index->words[id][len] != '\0')
+			continue;
+
+		symspell_update(index, word, len, id, 0);
+		free(index->words[id]);
+		index->words[id] = NULL;
+		index->free_ids[index->nfree++] = id;
+		return;
+	}
+}
+
+/******************************************************************************
+ * This function compares two ids, for qsort.
+ *****************************************************************************/
+static int symspell_cmp_ids(const void *a, const void *b)
+{
+	u32 x = *(const u32 *)a, y = *(const u32 *)b;
+
+	return (x > y) - (x < y);
+}
+
+/******************************************************************************
+ * This function compares two words, for qsort.
+ *****************************************************************************/
+static int symspell_cmp_words(const void *a, const void *b)
+{
+	return strcmp(*(char * const *)a, *(char * const *)b);
+}
+
+/******************************************************************************
+ * This function prints, in lexicographic order, the words of the index that
+ * have the same length as the given word and differ from it in at most k
+ * letters. The candidates are the words that share a variant of the given
+ * word with min(k, len) letters deleted, and every candidate is verified.
+ *
+ * @param index - A pointer to the index.
+ * @param word - The word to autocorrect.
+ * @param k - The maximum number of differences, at most
+ *            SYMSPELL_MAX_DISTANCE.
+ * @param out - The output buffer of the words.
+ *
+ * @return found - The number of words printed.
+ *****************************************************************************/
+int symspell_autocorrect(symspell_t *index, char *word, int k,
+						 io_buffer_t *out)
+{
+	int len = strlen(word);
+	int d = k < len ? k : len;
+	int pos[SYMSPELL_MAX_DISTANCE];
+	u32 n = 0, cap = 64;
+	int found = 0;
+
+	if (k < 0)
+		return 0;
+
+	u32 *ids = malloc(cap * sizeof(u32));
+	DIE(!ids, "Failed to allocate memory for the symspell candidates");
+
+	// Collect the ids of all the words that share a variant
+	for (int i = 0; i < d; i++)
+		pos[i] = i;
+	do {
+		symspell_slot_t *slot = symspell_find(index, symspell_hash(word, len,
+																	pos, d));
+
+		if (slot->hash == SYMSPELL_EMPTY)
+			continue;
+
+		for (u32 p = slot->head; p != SYMSPELL_NIL;
+			 p = index->postings[p].next) {
+			if (n == cap) {
+				cap *= 2;
+				ids = realloc(ids, cap * sizeof(u32));
+				DIE(!ids, "Failed to grow the symspell candidates");
+			}
+			ids[n++] = index->postings[p].word;
+		}
+	} while (symspell_next_positions(pos, d, len));
+
+	// A word may share several variants, so we drop the duplicates
+	qsort(ids, n, sizeof(u32), symspell_cmp_ids);
+
+	char **words = malloc((n + 1) * sizeof(char *));
+	DIE(!words, "Failed to allocate memory for the symspell results");
+
+	for (u32 i = 0; i < n; i++) {
+		char *candidate = index->words[ids[i]];
+		int count = 0;
+
+		if (i > 0 && ids[i] == ids[i - 1])
+			continue;
+
+		// Verify the candidate, the hashes of the variants may collide
+		if ((int)strlen(candidate) != len)
+			continue;
+		for (int j = 0; j < len && count <= k; j++)
+			count += candidate[j] != word[j];
+		if (count <= k)
+			words[found++] = candidate;
+	}
+
+	qsort(words, found, sizeof(char *), symspell_cmp_words);
+	for (int i = 0; i < found; i++)
+		io_write_line(out, words[i], len);
+
+	free(ids);
+	free(words);
+
+	return found;
+}
+
+/******************************************************************************
+ * This function returns the number of bytes used by the index.
+ *
+ * @param index - A pointer to the index.
+ *
+ * @return bytes - The size of the hash table, the postings and the words.
+ *****************************************************************************/
+size_t symspell_memory_usage(symspell_t *index)
+{
+	size_t bytes = sizeof(symspell_t);
+
+	bytes += (size_t)index->nslots * sizeof(symspell_slot_t);
+	bytes += (size_t)index->postings_cap * sizeof(symspell_posting_t);
+	bytes += (size_t)index->words_cap * (sizeof(char *) + sizeof(u32));
+	for (u32 i = 0; i < index->nwords; i++)
+		if (index->words[i])
+			bytes += strlen(index->words[i]) + 1;
+
+	return bytes;
+}
+
+/******************************************************************************
+ * This function frees the memory allocated by the index.
+ *
+ * @param pindex - A double pointer to the index.
+ *****************************************************************************/
+void symspell_free(symspell_t **pindex)
+{
+	symspell_t *index = *pindex;
+
+	for (u32 i = 0; i < index->nwords; i++)
+		free(index->words[i]);
+	free(index->words);
+	free(index->free_ids);
+	free(index->postings);
+	free(index->slots);
+	free(index);
+	*pindex = NULL;
+}
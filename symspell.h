@@ -0,0 +1,88 @@
+/* <Copyright Niculici Mihai-Daniel 2023 > */
+
+#ifndef SYMSPELL_H_
+#define SYMSPELL_H_
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include "types.h"
+#include "io.h"
+
+#ifndef DIE
+#define DIE(assertion, call_description)				\
+	do {								\
+		if (assertion) {					\
+			fprintf(stderr, "(%s, %d): ",			\
+					__FILE__, __LINE__);		\
+			perror(call_description);			\
+			exit(errno);				        \
+		}							\
+	} while (0)
+#endif
+
+/* Biggest tolerance answered by the index, bigger ones go to the trie */
+#define SYMSPELL_MAX_DISTANCE 2
+
+/* Number of hash table slots reserved when the index is created */
+#define SYMSPELL_INITIAL_SLOTS 4096
+
+/* Value of the end of a posting list */
+#define SYMSPELL_NIL 0xFFFFFFFFu
+
+/* Hash of an empty hash table slot, never produced by a variant */
+#define SYMSPELL_EMPTY 0
+
+/*
+ * A slot of the hash table of the delete variants. The key is the 64-bit
+ * hash of the variant, so two variants may share a slot: the candidates are
+ * always verified against the word, which makes collisions harmless.
+ */
+typedef struct symspell_slot_t symspell_slot_t;
+struct symspell_slot_t {
+	u64 hash;
+
+	/* First posting of the variant, SYMSPELL_NIL if it has none */
+	u32 head;
+};
+
+/* A posting: the id of a word that has the variant, and the next posting */
+typedef struct symspell_posting_t symspell_posting_t;
+struct symspell_posting_t {
+	u32 word;
+	u32 next;
+};
+
+typedef struct symspell_t symspell_t;
+struct symspell_t {
+	/* Hash table of the delete variants, a power of two in size */
+	symspell_slot_t *slots;
+	u32 nslots;
+	u32 used_slots;
+
+	/* Postings of all the variants, released ones are chained in free */
+	symspell_posting_t *postings;
+	u32 npostings;
+	u32 postings_cap;
+	u32 postings_free;
+
+	/* The words of the index, by id, NULL for the released ids */
+	char **words;
+	u32 nwords;
+	u32 words_cap;
+
+	/* Released ids, reused before new ones (at most words_cap of them) */
+	u32 *free_ids;
+	u32 nfree;
+};
+
+symspell_t *symspell_create(void);
+void symspell_add(symspell_t *index, char *word, int len);
+void symspell_remove(symspell_t *index, char *word, int len);
+int symspell_autocorrect(symspell_t *index, char *word, int k,
+						 io_buffer_t *out);
+size_t symspell_memory_usage(symspell_t *index);
+void symspell_free(symspell_t **pindex);
+
+#endif /* SYMSPELL_H_ */
@@ -1,37 +1,601 @@
 /* <Copyright Niculici Mihai-Daniel 2023 > */
 
+#define _POSIX_C_SOURCE 200809L
+
+#include <ctype.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include "trie.h"
+#include "dawg.h"
+#include "datrie.h"
+#include "concurrent.h"
+#include "cache.h"
+
+/******************************************************************************
+ * This function moves an arena into a bigger allocation. While readers run
+ * in the concurrent mode they may still read the old one, so it is copied
+ * and retired instead of reallocated.
+ *
+ * @param trie - A pointer to the trie data structure.
+ * @param arena - The arena.
+ * @param used - The number of bytes of the arena in use.
+ * @param bytes - The new size of the arena, in bytes.
+ *
+ * @return arena - The bigger arena, NULL if it cannot be allocated.
+ *****************************************************************************/
+static void *trie_grow_arena(trie_t *trie, void *arena, size_t used,
+							 size_t bytes)
+{
+	STATS_ADD(trie, bytes, bytes);
+	if (!trie->concurrent)
+		return realloc(arena, bytes);
+
+	void *grown = malloc(bytes);
+
+	if (grown) {
+		memcpy(grown, arena, used);
+		concurrent_retire_memory(trie->concurrent, arena);
+	}
+	return grown;
+}
 
 /******************************************************************************
- * This function creates a node by dynamically allocating it, then returns it.
+ * This function takes a node from the arena of the trie, growing the arena if
+ * it is full, and returns its index.
  *
- * @param ----------------
+ * @param trie - A pointer to the trie data structure.
  *
- * @return node - A pointer to the node created.
+ * @return node - The index of the node created.
  *****************************************************************************/
-trie_node_t *trie_create_node(void)
+u32 trie_create_node(trie_t *trie)
 {
-	// Allocating memory for the node
-	trie_node_t *node = (trie_node_t *)malloc(sizeof(trie_node_t));
-	DIE(!node, "Failed to allocate memory for trie node");
+	u32 node;
+
+	if (trie->free_list != TRIE_NIL) {
+		// Reuse a node released by a previous remove
+		node = trie->free_list;
+		trie->free_list = trie->nodes[node].children;
+	} else {
+		// Double the arena when every slot has been handed out
+		if (trie->nodes_used == trie->nodes_cap) {
+			trie->nodes_cap *= 2;
+			trie->nodes = trie_grow_arena(trie, trie->nodes,
+										  trie->nodes_used *
+										  sizeof(trie_node_t),
+										  trie->nodes_cap *
+										  sizeof(trie_node_t));
+			DIE(!trie->nodes, "Failed to grow the trie node arena");
+		}
+		node = trie->nodes_used++;
+	}
 
-	// Allocate memory for the children vector
-	node->children = (trie_node_t **) malloc(sizeof(trie_node_t *) *
-											 ALPHABET_SIZE);
-	DIE(!node->children, "Failed to allocate memory for trie node children");
+	// A new node has no children block until its first child is added
+	trie->nodes[node].children = TRIE_NIL;
+	trie->nodes[node].kind = TRIE_NODE_EMPTY;
 
-	// We initialize each of the children with NULL
-	for (int i = 0; i < ALPHABET_SIZE; i++)
-		node->children[i] = NULL;
+	// The subtree of a new node holds no word yet
+	trie->nodes[node].lex_dir = TRIE_NONE;
+	trie->nodes[node].short_dir = TRIE_NONE;
+	trie->nodes[node].freq_dir = TRIE_NONE;
+	trie->nodes[node].short_len = TRIE_NO_LENGTH;
+	trie->nodes[node].best_freq = 0;
+	trie->nodes[node].len_mask = 0;
+	trie->nodes[node].nwords = 0;
 
 	// We set the other fields to 0.
-	node->n_children = 0;
-	node->end_of_word = 0;
+	trie->nodes[node].n_children = 0;
+	trie->nodes[node].end_of_word = 0;
 
 	// Return the node
 	return node;
 }
 
+/******************************************************************************
+ * This function gives a node back to the arena so that it can be reused.
+ *
+ * @param trie - A pointer to the trie data structure.
+ * @param node - The index of the node that is released.
+ *****************************************************************************/
+void trie_free_node(trie_t *trie, u32 node)
+{
+	trie->nodes[node].children = trie->free_list;
+	trie->free_list = node;
+}
+
+/******************************************************************************
+ * This function returns the capacity of a children block of the given kind.
+ *
+ * @param trie - A pointer to the trie data structure.
+ * @param kind - The kind of the node.
+ *
+ * @return capacity - The maximum number of children of the kind.
+ *****************************************************************************/
+static int trie_kind_cap(trie_t *trie, int kind)
+{
+	switch (kind) {
+	case TRIE_NODE_TINY:
+		return TRIE_TINY_CAP;
+	case TRIE_NODE_MEDIUM:
+		return TRIE_MEDIUM_CAP;
+	case TRIE_NODE_FULL:
+		return trie->alphabet_size;
+	default:
+		return 0;
+	}
+}
+
+/******************************************************************************
+ * This function returns the number of pool slots of a block of the given kind.
+ * A sparse block packs its key bytes in the first slots, before the children.
+ *
+ * @param trie - A pointer to the trie data structure.
+ * @param kind - The kind of the node.
+ *
+ * @return slots - The size of the block, in 32-bit slots.
+ *****************************************************************************/
+static int trie_kind_slots(trie_t *trie, int kind)
+{
+	if (kind == TRIE_NODE_FULL)
+		return trie->alphabet_size;
+	return (trie_kind_cap(trie, kind) + 3) / 4 + trie_kind_cap(trie, kind);
+}
+
+/******************************************************************************
+ * This function takes a children block of the given kind from the pool,
+ * growing the pool if it is full.
+ *
+ * @param trie - A pointer to the trie data structure.
+ * @param kind - The kind of the block.
+ *
+ * @return block - The offset of the block in the pool.
+ *****************************************************************************/
+static u32 trie_alloc_block(trie_t *trie, int kind)
+{
+	u32 block = trie->kids_free[kind];
+	u32 slots = trie_kind_slots(trie, kind);
+
+	if (block != TRIE_NIL) {
+		// Reuse a block of the same kind
+		trie->kids_free[kind] = trie->kids[block];
+	} else {
+		// Double the pool until the block fits
+		while (trie->kids_used + slots > trie->kids_cap) {
+			trie->kids_cap *= 2;
+			trie->kids = trie_grow_arena(trie, trie->kids,
+										 trie->kids_used * sizeof(u32),
+										 trie->kids_cap * sizeof(u32));
+			DIE(!trie->kids, "Failed to grow the trie child pool");
+		}
+		block = trie->kids_used;
+		trie->kids_used += slots;
+	}
+
+	// A FULL block starts with every letter missing
+	if (kind == TRIE_NODE_FULL)
+		for (int i = 0; i < trie->alphabet_size; i++)
+			trie->kids[block + i] = TRIE_NIL;
+
+	return block;
+}
+
+/******************************************************************************
+ * This function gives a children block back to the pool.
+ *
+ * @param trie - A pointer to the trie data structure.
+ * @param block - The offset of the block in the pool.
+ * @param kind - The kind of the block.
+ *****************************************************************************/
+void trie_free_block(trie_t *trie, u32 block, int kind)
+{
+	trie->kids[block] = trie->kids_free[kind];
+	trie->kids_free[kind] = block;
+}
+
+/******************************************************************************
+ * This function takes a children block of the given kind from the pool and
+ * fills it with children.
+ *
+ * @param trie - A pointer to the trie data structure.
+ * @param kind - The kind of the block.
+ * @param letters - The letters of the children, sorted.
+ * @param children - The indices of the children.
+ * @param n - The number of children, at most the capacity of the kind.
+ *
+ * @return block - The offset of the block in the pool, TRIE_NIL for the
+ *                 EMPTY kind.
+ *****************************************************************************/
+static u32 trie_fill_block(trie_t *trie, int kind, u8 *letters,
+						   u32 *children, int n)
+{
+	if (kind == TRIE_NODE_EMPTY)
+		return TRIE_NIL;
+
+	u32 block = trie_alloc_block(trie, kind);
+
+	// Copy the children, keeping the letters sorted
+	if (kind == TRIE_NODE_FULL) {
+		for (int i = 0; i < n; i++)
+			trie->kids[block + letters[i]] = children[i];
+	} else {
+		u8 *keys = (u8 *)&trie->kids[block];
+		u32 *slots = &trie->kids[block] + trie_kind_slots(trie, kind) -
+						  trie_kind_cap(trie, kind);
+
+		for (int i = 0; i < n; i++) {
+			keys[i] = letters[i];
+			slots[i] = children[i];
+		}
+	}
+
+	return block;
+}
+
+/******************************************************************************
+ * This function moves the children of a node into a block of another kind.
+ *
+ * @param trie - A pointer to the trie data structure.
+ * @param node - The index of the node.
+ * @param kind - The new kind of the node.
+ *****************************************************************************/
+static void trie_set_kind(trie_t *trie, u32 node, int kind)
+{
+	u8 letters[TRIE_MAX_ALPHABET];
+	u32 children[TRIE_MAX_ALPHABET];
+	int n = trie_children(trie, node, letters, children);
+	u32 block = trie_fill_block(trie, kind, letters, children, n);
+
+	if (trie->nodes[node].kind != TRIE_NODE_EMPTY)
+		trie_free_block(trie, trie->nodes[node].children,
+						trie->nodes[node].kind);
+	trie->nodes[node].children = block;
+	trie->nodes[node].kind = kind;
+}
+
+/******************************************************************************
+ * This function returns the child of a node for the given letter.
+ *
+ * @param trie - A pointer to the trie data structure.
+ * @param node - The index of the node.
+ * @param letter - The letter, as an index in the alphabet.
+ *
+ * @return child - The index of the child, TRIE_NIL if it is missing.
+ *****************************************************************************/
+u32 trie_child(trie_t *trie, u32 node, int letter)
+{
+	trie_node_t *current = &trie->nodes[node];
+	u32 *block = &trie->kids[current->children];
+
+	STATS_ADD(trie, nodes, 1);
+
+	switch (current->kind) {
+	case TRIE_NODE_FULL:
+		return block[letter];
+	case TRIE_NODE_TINY:
+	case TRIE_NODE_MEDIUM:
+		// The keys are sorted, so we stop at the first bigger one
+		for (int i = 0; i < current->n_children; i++) {
+			int key = ((u8 *)block)[i];
+
+			if (key == letter)
+				return block[trie_kind_slots(trie, current->kind) -
+							 trie_kind_cap(trie, current->kind) + i];
+			if (key > letter)
+				break;
+		}
+		return TRIE_NIL;
+	default:
+		return TRIE_NIL;
+	}
+}
+
+/******************************************************************************
+ * This function adds, replaces or (when child is TRIE_NIL) removes the child
+ * of a node for the given letter. The node grows into a bigger kind when its
+ * block is full and shrinks into a smaller kind when it becomes sparse.
+ *
+ * @param trie - A pointer to the trie data structure.
+ * @param node - The index of the node.
+ * @param letter - The letter, as an index in the alphabet.
+ * @param child - The index of the new child or TRIE_NIL.
+ *****************************************************************************/
+void trie_set_child(trie_t *trie, u32 node, int letter, u32 child)
+{
+	trie_node_t *current = &trie->nodes[node];
+	int present = trie_child(trie, node, letter) != TRIE_NIL;
+
+	// Grow the node before adding a child to a full block
+	if (!present && child != TRIE_NIL &&
+		current->n_children == trie_kind_cap(trie, current->kind)) {
+		trie_set_kind(trie, node, current->kind + 1);
+		current = &trie->nodes[node];
+	}
+
+	if (current->kind == TRIE_NODE_FULL) {
+		trie->kids[current->children + letter] = child;
+	} else {
+		u8 *keys = (u8 *)&trie->kids[current->children];
+		u32 *slots = &trie->kids[current->children] +
+						  trie_kind_slots(trie, current->kind) -
+						  trie_kind_cap(trie, current->kind);
+		int pos = 0;
+
+		while (pos < current->n_children && keys[pos] < letter)
+			pos++;
+
+		if (present && child != TRIE_NIL) {
+			slots[pos] = child;
+		} else if (present) {
+			// Shift the bigger keys over the removed one
+			for (int i = pos; i < current->n_children - 1; i++) {
+				keys[i] = keys[i + 1];
+				slots[i] = slots[i + 1];
+			}
+		} else if (child != TRIE_NIL) {
+			// Shift the bigger keys to make room for the new one
+			for (int i = current->n_children; i > pos; i--) {
+				keys[i] = keys[i - 1];
+				slots[i] = slots[i - 1];
+			}
+			keys[pos] = letter;
+			slots[pos] = child;
+		}
+	}
+
+	if (!present && child != TRIE_NIL)
+		current->n_children++;
+	if (!present || child != TRIE_NIL)
+		return;
+	current->n_children--;
+
+	// Shrink the node once its children fit in a smaller block
+	if (current->n_children == 0)
+		trie_set_kind(trie, node, TRIE_NODE_EMPTY);
+	else if (current->kind > TRIE_NODE_TINY &&
+			 current->n_children < trie_kind_cap(trie, current->kind - 1))
+		trie_set_kind(trie, node, current->kind - 1);
+}
+
+/******************************************************************************
+ * This function gives the writer a node of its own to change. In the
+ * concurrent mode the published nodes are never changed: the node and its
+ * children block are copied and the original is retired, so every change
+ * copies the path from the root down to it. Otherwise the node itself is
+ * returned.
+ *
+ * @param trie - A pointer to the trie data structure.
+ * @param node - The index of the node.
+ *
+ * @return node - The index of the node to change.
+ *****************************************************************************/
+static u32 trie_own(trie_t *trie, u32 node)
+{
+	if (!trie->concurrent)
+		return node;
+
+	u32 copy = trie_create_node(trie);
+	int kind = trie->nodes[node].kind;
+
+	trie->nodes[copy] = trie->nodes[node];
+	if (kind != TRIE_NODE_EMPTY) {
+		u32 block = trie_alloc_block(trie, kind);
+
+		memcpy(&trie->kids[block], &trie->kids[trie->nodes[node].children],
+			   trie_kind_slots(trie, kind) * sizeof(u32));
+		trie->nodes[copy].children = block;
+	}
+	concurrent_retire_node(trie, node);
+
+	return copy;
+}
+
+/******************************************************************************
+ * This function copies the children of a node, sorted by letter.
+ *
+ * @param trie - A pointer to the trie data structure.
+ * @param node - The index of the node.
+ * @param letters - Buffer for the letters of the children.
+ * @param children - Buffer for the indices of the children.
+ *
+ * @return n - The number of children of the node.
+ *****************************************************************************/
+int trie_children(trie_t *trie, u32 node, u8 *letters,
+				  u32 *children)
+{
+	trie_node_t *current = &trie->nodes[node];
+	u32 *block = &trie->kids[current->children];
+	int n = 0;
+
+	STATS_ADD(trie, nodes, 1);
+
+	if (current->kind == TRIE_NODE_FULL) {
+		for (int i = 0; i < trie->alphabet_size; i++) {
+			if (block[i] != TRIE_NIL) {
+				letters[n] = i;
+				children[n++] = block[i];
+			}
+		}
+	} else if (current->kind != TRIE_NODE_EMPTY) {
+		u32 *slots = block + trie_kind_slots(trie, current->kind) -
+						  trie_kind_cap(trie, current->kind);
+
+		for (; n < current->n_children; n++) {
+			letters[n] = ((u8 *)block)[n];
+			children[n] = slots[n];
+		}
+	}
+
+	return n;
+}
+
+/******************************************************************************
+ * This function finds the first child of a node from a letter on, in the
+ * order of the letters.
+ *
+ * @param trie - A pointer to the trie data structure.
+ * @param node - The index of the node.
+ * @param letter - The first letter to look at.
+ * @param child - A pointer to the index of the child found.
+ *
+ * @return letter - The letter of the child, -1 if there is no such child.
+ *****************************************************************************/
+int trie_next_child(trie_t *trie, u32 node, int letter, u32 *child)
+{
+	trie_node_t *current = &trie->nodes[node];
+	u32 *block = &trie->kids[current->children];
+
+	STATS_ADD(trie, nodes, 1);
+
+	if (current->kind == TRIE_NODE_FULL) {
+		for (; letter < trie->alphabet_size; letter++) {
+			if (block[letter] != TRIE_NIL) {
+				*child = block[letter];
+				return letter;
+			}
+		}
+	} else if (current->kind != TRIE_NODE_EMPTY) {
+		// The keys are sorted, so the first one that is not smaller wins
+		for (int i = 0; i < current->n_children; i++) {
+			int key = ((u8 *)block)[i];
+
+			if (key >= letter) {
+				*child = block[trie_kind_slots(trie, current->kind) -
+							   trie_kind_cap(trie, current->kind) + i];
+				return key;
+			}
+		}
+	}
+
+	return -1;
+}
+
+/******************************************************************************
+ * This function recomputes the summaries of a node from its own word and the
+ * summaries of its children. The children are visited in lexicographic order
+ * and a child only replaces the current best when it is strictly better, so
+ * ties go to the lexicographically smallest word.
+ *
+ * @param trie - A pointer to the trie data structure.
+ * @param node - The index of the node.
+ *
+ * @return changed - 1 if the summaries of the node changed, 0 otherwise. The
+ *                   ancestors of an unchanged node do not need an update.
+ *****************************************************************************/
+int trie_update_summary(trie_t *trie, u32 node)
+{
+	u8 letters[TRIE_MAX_ALPHABET];
+	u32 children[TRIE_MAX_ALPHABET];
+	int n = trie_children(trie, node, letters, children);
+	trie_node_t *current = &trie->nodes[node];
+	trie_node_t old = *current;
+
+	// The word of the node itself comes before all the words below it
+	if (current->end_of_word != 0) {
+		current->lex_dir = TRIE_SELF;
+		current->short_dir = TRIE_SELF;
+		current->freq_dir = TRIE_SELF;
+		current->short_len = 0;
+		current->best_freq = current->end_of_word;
+		current->len_mask = 1;
+		current->nwords = 1;
+	} else {
+		current->lex_dir = TRIE_NONE;
+		current->short_dir = TRIE_NONE;
+		current->freq_dir = TRIE_NONE;
+		current->short_len = TRIE_NO_LENGTH;
+		current->best_freq = 0;
+		current->len_mask = 0;
+		current->nwords = 0;
+	}
+
+	for (int i = 0; i < n; i++) {
+		trie_node_t *child = &trie->nodes[children[i]];
+
+		if (child->lex_dir == TRIE_NONE)
+			continue;
+
+		current->nwords += child->nwords;
+
+		// The words of the child are one letter longer, the longest ones
+		// stay in the last bit
+		current->len_mask |= (child->len_mask << 1) |
+			(child->len_mask & (1u << (TRIE_MASK_LENGTHS - 1)));
+
+		// The first non-empty child holds the smallest word
+		if (current->lex_dir == TRIE_NONE)
+			current->lex_dir = letters[i];
+
+		if (child->short_len + 1 < current->short_len) {
+			current->short_dir = letters[i];
+			current->short_len = child->short_len + 1;
+		}
+
+		if (child->best_freq > current->best_freq) {
+			current->freq_dir = letters[i];
+			current->best_freq = child->best_freq;
+		}
+	}
+
+	return old.lex_dir != current->lex_dir ||
+		   old.short_dir != current->short_dir ||
+		   old.freq_dir != current->freq_dir ||
+		   old.short_len != current->short_len ||
+		   old.best_freq != current->best_freq ||
+		   old.len_mask != current->len_mask ||
+		   old.nwords != current->nwords;
+}
+
+/******************************************************************************
+ * This function updates the summaries of a node after the subtree of one of
+ * its children gained a word or a higher frequency. Nothing got worse, so
+ * only that child has to be compared with the current summaries, keeping the
+ * same tie rules as trie_update_summary.
+ *
+ * @param trie - A pointer to the trie data structure.
+ * @param node - The index of the node.
+ * @param letter - The letter of the child.
+ * @param child - The index of the child.
+ *
+ * @return changed - 1 if the summaries of the node changed, 0 otherwise.
+ *****************************************************************************/
+static int trie_update_summary_child(trie_t *trie, u32 node, int letter,
+									 u32 child)
+{
+	trie_node_t *current = &trie->nodes[node];
+	trie_node_t *below = &trie->nodes[child];
+	trie_node_t old = *current;
+	int len = below->short_len + 1;
+
+	if (current->lex_dir == TRIE_NONE ||
+		(current->lex_dir != TRIE_SELF && letter < current->lex_dir))
+		current->lex_dir = letter;
+
+	if (current->short_dir == letter || len < current->short_len ||
+		(len == current->short_len && current->short_dir != TRIE_SELF &&
+		 letter < current->short_dir)) {
+		current->short_dir = letter;
+		current->short_len = len;
+	}
+
+	if (current->freq_dir == letter || below->best_freq > current->best_freq ||
+		(below->best_freq == current->best_freq &&
+		 current->freq_dir != TRIE_SELF && letter < current->freq_dir)) {
+		current->freq_dir = letter;
+		current->best_freq = below->best_freq;
+	}
+
+	current->len_mask |= (below->len_mask << 1) |
+		(below->len_mask & (1u << (TRIE_MASK_LENGTHS - 1)));
+
+	return old.lex_dir != current->lex_dir ||
+		   old.short_dir != current->short_dir ||
+		   old.freq_dir != current->freq_dir ||
+		   old.short_len != current->short_len ||
+		   old.best_freq != current->best_freq ||
+		   old.len_mask != current->len_mask;
+}
+
 /******************************************************************************
  * This function creates a trie, allocates it dynamically, and then returns it.
  *
@@ -46,646 +610,2552 @@ trie_t *trie_create(int alphabet_size, char *alphabet)
 	trie_t *trie = (trie_t *)malloc(sizeof(trie_t));
 	DIE(!trie, "Failed to allocate memory for trie");
 
+	// Allocating the node arena, slot 0 is kept as the TRIE_NIL sentinel
+	trie->nodes = malloc(TRIE_INITIAL_NODES * sizeof(trie_node_t));
+	DIE(!trie->nodes, "Failed to allocate memory for the trie node arena");
+	trie->nodes_cap = TRIE_INITIAL_NODES;
+	trie->nodes_used = TRIE_NIL + 1;
+	trie->free_list = TRIE_NIL;
+
+	// Allocating the child pool, offset 0 is never handed out as a block
+	trie->kids = malloc(TRIE_INITIAL_KIDS * sizeof(u32));
+	DIE(!trie->kids, "Failed to allocate memory for the trie child pool");
+	trie->kids_cap = TRIE_INITIAL_KIDS;
+	trie->kids_used = TRIE_NIL + 1;
+#ifdef TRIE_STATS
+	memset(&trie->stats, 0, sizeof(trie->stats));
+#endif
+	STATS_ADD(trie, bytes, TRIE_INITIAL_NODES * sizeof(trie_node_t) +
+			  TRIE_INITIAL_KIDS * sizeof(u32));
+	for (int i = 0; i < TRIE_NODE_KINDS; i++)
+		trie->kids_free[i] = TRIE_NIL;
+
 	// We create the root node
-	trie->root = trie_create_node();
+	trie->root = trie_create_node(trie);
 
 	// We set the other fields to 0.
 	trie->size = 0;
-	trie->alphabet_size = alphabet_size;
-	trie->alphabet = alphabet;
+	trie->nwords = 0;
 	trie->nnodes = 1;
+	trie->dead_nodes = 0;
+	trie->compact_percent = TRIE_COMPACT_PERCENT;
+	trie->symspell = NULL;
+	trie->wordstore = NULL;
+	trie->scan_distance = WORDSTORE_MIN_DISTANCE;
+	trie->load_threads = 1;
+	trie->frozen = 0;
+	trie->freqs = NULL;
+	trie->freq_max = NULL;
+	trie->image = NULL;
+	trie->image_size = 0;
+	trie->datrie = NULL;
+	trie->out = NULL;
+	trie->concurrent = NULL;
+	trie->cache = NULL;
+
+	DIE(trie_set_alphabet(trie, alphabet, alphabet_size) < 0,
+		"Invalid trie alphabet");
+
+	// Return the trie
+	return trie;
+}
+
+/******************************************************************************
+ * This function sets the alphabet of a trie and its tokenizer table. The
+ * symbols are sorted and their duplicates dropped, so that the order of the
+ * dense letter indices is the order of the bytes and the words still come
+ * out in strcmp order. The trie must hold no children yet.
+ *
+ * @param trie - A pointer to the trie data structure.
+ * @param alphabet - The symbols of the alphabet.
+ * @param alphabet_size - The number of symbols.
+ *
+ * @return status - 0 on success, -1 if a symbol is a separator or if there
+ *                  are more than TRIE_MAX_ALPHABET symbols.
+ *****************************************************************************/
+int trie_set_alphabet(trie_t *trie, const char *alphabet, int alphabet_size)
+{
+	u8 present[256] = {0};
+	int n = 0;
+
+	for (int i = 0; i < alphabet_size; i++) {
+		unsigned char c = alphabet[i];
+
+		if (c == '\0' || isspace(c))
+			return -1;
+		present[c] = 1;
+	}
+	for (int c = 0; c < 256; c++)
+		n += present[c];
+	if (n == 0 || n > TRIE_MAX_ALPHABET)
+		return -1;
+
+	trie->alphabet_size = 0;
+	for (int c = 0; c < 256; c++)
+		if (present[c])
+			trie->alphabet[trie->alphabet_size++] = c;
+	trie->alphabet[trie->alphabet_size] = '\0';
+
+	// Every symbol folds to its own index, and the other case of a letter
+	// to the index of the letter, unless it is a symbol as well
+	memset(trie->fold, 0, sizeof(trie->fold));
+	for (int i = 0; i < n; i++)
+		trie->fold[(unsigned char)trie->alphabet[i]] = i + 1;
+	for (int i = 0; i < n; i++) {
+		unsigned char c = trie->alphabet[i];
+		unsigned char other = isupper(c) ? tolower(c) : toupper(c);
+
+		if (!present[other])
+			trie->fold[other] = i + 1;
+	}
+
+	// The FULL blocks that were released have the size of the old alphabet
+	trie->kids_free[TRIE_NODE_FULL] = TRIE_NIL;
+
+	return 0;
+}
+
+/******************************************************************************
+ * This function counts a word that is new to the trie, on the nodes of its
+ * path, and adds it to the AUTOCORRECT engines that keep their own index.
+ *
+ * @param trie - A pointer to the trie data structure.
+ * @param path - The nodes of the word, from the root to its end.
+ * @param token - The word, as it was read.
+ * @param len - The length of the word.
+ * @param revived - The number of nodes of the path that REMOVE had left
+ *                  without a word.
+ *****************************************************************************/
+static void trie_count_word(trie_t *trie, u32 *path, const char *token,
+							int len, int revived)
+{
+	trie->nwords++;
+	trie->dead_nodes -= revived;
+	for (int j = 0; j <= len; j++)
+		trie->nodes[path[j]].nwords++;
+
+	if (trie->symspell || trie->wordstore) {
+		char word[MAX_STRING_SIZE];
+
+		for (int j = 0; j < len; j++)
+			word[j] = trie->alphabet[trie->fold[(unsigned char)token[j]] - 1];
+		if (trie->symspell)
+			symspell_add(trie->symspell, word, len);
+		if (trie->wordstore)
+			wordstore_add(trie->wordstore, word, len);
+	}
+}
+
+/******************************************************************************
+ * This function inserts a token into the trie, count times. The letters are
+ * folded through the tokenizer table, so the token can be read straight from
+ * the file, without copying it. Every byte of the token has to fold to a
+ * letter and the token has to be shorter than MAX_STRING_SIZE.
+ *
+ * @param trie - A pointer to the trie data structure.
+ * @param token - The letters of the word, not terminated by '\0'.
+ * @param len - The length of the word.
+ * @param count - The number of occurrences of the word.
+ *****************************************************************************/
+void trie_insert_token(trie_t *trie, const char *token, int len, int count)
+{
+	// A frozen or mapped trie cannot be changed in place
+	trie_make_writable(trie);
+
+	// Start from the root
+	trie->root = trie_own(trie, trie->root);
+	u32 node = trie->root;
+
+	// The nodes on the path of the word, whose summaries may change
+	u32 path[MAX_STRING_SIZE + 1];
+	int i, revived = 0;
+
+	// Iterate through the word
+	for (i = 0; i < len; i++) {
+		int letter = trie->fold[(unsigned char)token[i]] - 1;
+
+		path[i] = node;
+
+		u32 next = trie_child(trie, node, letter);
+
+		// If the current letter is not in the trie, we add it
+		if (next == TRIE_NIL) {
+			// Create a new node and link it to the current one
+			next = trie_create_node(trie);
+			trie_set_child(trie, node, letter, next);
+
+			// Increment the number of nodes in the trie
+			trie->nnodes++;
+		} else {
+			// A node that REMOVE left without a word gets one again
+			revived += trie->nodes[next].nwords == 0;
+
+			// The readers keep the old node, the path gets a copy
+			if (trie->concurrent) {
+				next = trie_own(trie, next);
+				trie_set_child(trie, node, letter, next);
+			}
+		}
+
+		// Go to the next node
+		node = next;
+	}
+	path[len] = node;
+
+	// Mark the end of the word
+	if (trie->nodes[node].end_of_word == 0)
+		trie_count_word(trie, path, token, len, revived);
+	trie->nodes[node].end_of_word += count;
+
+	// Increment the size of the trie
+	trie->size += count;
+
+	// The cached results that depend on the path are out of date, and the
+	// ones that depend on the words of the length if the word is new
+	if (trie->cache) {
+		cache_change(trie->cache,
+					 trie->nodes[node].end_of_word == count ? len : -1);
+		for (int j = 0; j <= len; j++)
+			cache_touch(trie->cache, path[j]);
+	}
+
+	// Update the summaries from the end of the word up to the root, until
+	// a node does not change
+	if (trie_update_summary(trie, node))
+		while (i-- > 0 &&
+			   trie_update_summary_child(trie, path[i],
+										 trie->fold[(unsigned char)token[i]]
+										 - 1, path[i + 1]))
+			;
+
+	// The readers see the whole change at once
+	if (trie->concurrent)
+		concurrent_publish(trie);
+}
+
+/******************************************************************************
+ * This function copies a word with every letter replaced by its symbol in
+ * the alphabet, the way it is stored in the trie.
+ *
+ * @param trie - A pointer to the trie data structure.
+ * @param key - The word.
+ * @param word - Buffer of MAX_STRING_SIZE bytes for the stored word.
+ *
+ * @return len - The length of the word, -1 if it has a character outside of
+ *               the alphabet or if it is too long to be in the trie.
+ *****************************************************************************/
+static int trie_fold_word(trie_t *trie, const char *key, char *word)
+{
+	int len = strlen(key);
+
+	if (len >= MAX_STRING_SIZE)
+		return -1;
+	for (int i = 0; i < len; i++) {
+		int letter = trie->fold[(unsigned char)key[i]] - 1;
+
+		if (letter < 0)
+			return -1;
+		word[i] = trie->alphabet[letter];
+	}
+	word[len] = '\0';
+
+	return len;
+}
+
+/******************************************************************************
+ * This function inserts a word into the trie.
+ *
+ * @param trie - A pointer to the trie data structure.
+ * @param key - The word that has to be inserted in the trie. A word with a
+ *              character outside of the alphabet is ignored.
+ *****************************************************************************/
+void trie_insert(trie_t *trie, char *key)
+{
+	int len = strlen(key);
+
+	if (len >= MAX_STRING_SIZE)
+		return;
+	for (int i = 0; i < len; i++)
+		if (trie->fold[(unsigned char)key[i]] == 0)
+			return;
+
+	trie_insert_token(trie, key, len, 1);
+}
+
+/******************************************************************************
+ * This function searches for a word in the trie and returns it.
+ *
+ * @param trie - A pointer to the trie data structure.
+ * @param key - The word that has to be searched in the trie.
+ *
+ * @return node - A pointer to the node that contains the word. It stays valid
+ *                only until the next insertion in the trie.
+ *****************************************************************************/
+void *trie_search(trie_t *trie, char *key)
+{
+	// Verify if the word exists
+	if (!key[0])
+		return &trie->nodes[trie->root];
+
+	// Walk the letters of the word, on the nodes or on the double array
+	u32 node = trie_find_prefix(trie, key);
+
+	// If the current letter is not in the trie, return NULL
+	if (node == TRIE_NIL)
+		return NULL;
+
+	// If the word exists, return the node
+	if (trie->nodes[node].end_of_word != 0)
+		return &trie->nodes[node];
+	// Otherwise, return NULL
+	return NULL;
+}
+
+/******************************************************************************
+ * This function stamps the path of a word that is about to be removed with a
+ * new generation of the cache, so that the results which depend on it are
+ * computed again. A word that is not in the trie changes nothing.
+ *
+ * @param trie - A pointer to the trie data structure.
+ * @param word - The word, as it is stored.
+ *****************************************************************************/
+static void trie_touch_word(trie_t *trie, char *word)
+{
+	u32 path[MAX_STRING_SIZE + 1];
+	int len = 0;
+
+	path[0] = trie->root;
+	while (word[len]) {
+		int letter = trie->fold[(unsigned char)word[len]] - 1;
+
+		path[len + 1] = trie_child(trie, path[len], letter);
+		if (path[len + 1] == TRIE_NIL)
+			return;
+		len++;
+	}
+	if (trie->nodes[path[len]].end_of_word == 0)
+		return;
+
+	cache_change(trie->cache, len);
+	for (int i = 0; i <= len; i++)
+		cache_touch(trie->cache, path[i]);
+}
+
+/******************************************************************************
+ * This function removes a word from the trie.
+ *
+ * @param trie - A pointer to the trie data structure.
+ * @param key - The word that has to be removed from the trie. Its letters
+ *              are folded like the ones of an inserted word.
+ *****************************************************************************/
+void trie_remove(trie_t *trie, char *key)
+{
+	char word[MAX_STRING_SIZE];
+	u32 path[MAX_STRING_SIZE + 1];
+	int len = trie_fold_word(trie, key, word);
+
+	// A word with a character outside of the alphabet is not in the trie
+	if (len < 0)
+		return;
+
+	// A frozen or mapped trie cannot be changed in place
+	trie_make_writable(trie);
+
+	// Walk the word once, nothing changes if it is not in the trie
+	path[0] = trie->root;
+	for (int i = 0; i < len; i++) {
+		path[i + 1] = trie_child(trie, path[i],
+								 trie->fold[(unsigned char)word[i]] - 1);
+		if (path[i + 1] == TRIE_NIL)
+			return;
+	}
+	if (trie->nodes[path[len]].end_of_word == 0)
+		return;
+
+	if (trie->cache)
+		trie_touch_word(trie, word);
+
+	// The readers keep the old nodes, the path gets copies
+	if (trie->concurrent) {
+		path[0] = trie_own(trie, path[0]);
+		trie->root = path[0];
+		for (int i = 0; i < len; i++) {
+			path[i + 1] = trie_own(trie, path[i + 1]);
+			trie_set_child(trie, path[i],
+						   trie->fold[(unsigned char)word[i]] - 1,
+						   path[i + 1]);
+		}
+	}
+
+	// Only the mark of the word goes away, its nodes stay for the next
+	// compaction
+	trie->size -= trie->nodes[path[len]].end_of_word;
+	trie->nwords--;
+	if (trie->symspell)
+		symspell_remove(trie->symspell, word, len);
+	if (trie->wordstore)
+		wordstore_remove(trie->wordstore, word, len);
+	trie->nodes[path[len]].end_of_word = 0;
+
+	// The word may have been the best one of every subtree on its path, and
+	// the nodes left without a word are counted
+	for (int i = len; i >= 0; i--) {
+		trie_update_summary(trie, path[i]);
+		if (i > 0 && trie->nodes[path[i]].nwords == 0)
+			trie->dead_nodes++;
+	}
+
+	// The readers see the whole change at once
+	if (trie->concurrent)
+		concurrent_publish(trie);
+	else if (trie->compact_percent > 0 &&
+			 trie->dead_nodes >= TRIE_COMPACT_MIN_NODES &&
+			 (long)trie->dead_nodes * 100 >=
+			 (long)trie->nnodes * trie->compact_percent)
+		trie_compact(trie);
+}
+
+/******************************************************************************
+ * This function reclaims the nodes that REMOVE left without any word, in a
+ * single pass that copies the other ones into new arenas. The copies are
+ * placed in depth-first order, with the children of a node side by side, so
+ * the walk of a prefix and the scan of a node's children read nearby memory,
+ * and the new arenas have no released node or block.
+ *
+ * @param trie - A pointer to the trie data structure.
+ *
+ * @return status - 0 on success, -1 in the concurrent mode, whose readers
+ *                  still walk the old arenas.
+ *****************************************************************************/
+int trie_compact(trie_t *trie)
+{
+	u8 letters[TRIE_MAX_ALPHABET];
+	u32 children[TRIE_MAX_ALPHABET], originals[TRIE_MAX_ALPHABET];
+
+	if (trie->concurrent)
+		return -1;
+
+	// A frozen trie has no empty branches: dawg_freeze leaves them out
+	if (trie->frozen)
+		return 0;
+
+	trie_t *fresh = trie_create(trie->alphabet_size, trie->alphabet);
+
+	// The nodes whose children are still to be copied, with their copies
+	u32 (*stack)[2] = malloc(MAX_STRING_SIZE * TRIE_MAX_ALPHABET *
+							 sizeof(*stack));
+	DIE(!stack, "Failed to allocate the compaction stack");
+	int top = 0;
+
+	fresh->nodes[fresh->root] = trie->nodes[trie->root];
+	stack[top][0] = trie->root;
+	stack[top++][1] = fresh->root;
+
+	while (top > 0) {
+		u32 node = stack[--top][0], copy = stack[top][1];
+		int n = trie_children(trie, node, letters, children), live = 0;
+		int kind = TRIE_NODE_EMPTY;
+
+		// The children with words get a copy, with their own summaries
+		for (int i = 0; i < n; i++) {
+			if (trie->nodes[children[i]].nwords == 0)
+				continue;
+			letters[live] = letters[i];
+			originals[live] = children[i];
+			children[live] = trie_create_node(fresh);
+			fresh->nodes[children[live]] = trie->nodes[originals[live]];
+			fresh->nnodes++;
+			live++;
+		}
+
+		// The copies of the children go to a block of the smallest kind
+		while (kind < TRIE_NODE_FULL && trie_kind_cap(fresh, kind) < live)
+			kind++;
+		fresh->nodes[copy].children = trie_fill_block(fresh, kind, letters,
+													  children, live);
+		fresh->nodes[copy].kind = kind;
+		fresh->nodes[copy].n_children = live;
+
+		// The first child is copied next, so its subtree follows it
+		for (int i = live - 1; i >= 0; i--) {
+			stack[top][0] = originals[i];
+			stack[top++][1] = children[i];
+		}
+	}
+	free(stack);
+
+	trie_take_arenas(trie, fresh);
+	trie->dead_nodes = 0;
+	return 0;
+}
+
+/******************************************************************************
+ * This function frees the memory allocated by a trie. All the nodes live in
+ * the same arena, so they are released at once.
+ *
+ * @param ptrie - A double pointer to the trie data structure.
+ *****************************************************************************/
+void trie_free(trie_t **ptrie)
+{
+	if ((*ptrie)->concurrent)
+		concurrent_disable(*ptrie);
+	if ((*ptrie)->symspell)
+		symspell_free(&(*ptrie)->symspell);
+	if ((*ptrie)->wordstore)
+		wordstore_free(&(*ptrie)->wordstore);
+	if ((*ptrie)->cache)
+		cache_free(&(*ptrie)->cache);
+	trie_release_arenas(*ptrie);
+	free(*ptrie);
+	*ptrie = NULL;
+}
+
+/******************************************************************************
+ * This function releases the arenas and the frequency tables of a trie: they
+ * are freed, or unmapped if they belong to a snapshot opened with OPEN.
+ *
+ * @param trie - A pointer to the trie data structure.
+ *****************************************************************************/
+void trie_release_arenas(trie_t *trie)
+{
+	// The double array and the cached results refer to the nodes that go
+	// away
+	if (trie->datrie)
+		datrie_free(&trie->datrie);
+	if (trie->cache)
+		cache_clear(trie->cache);
+
+	if (trie->image) {
+		munmap(trie->image, trie->image_size);
+		trie->image = NULL;
+	} else {
+		free(trie->nodes);
+		free(trie->kids);
+		free(trie->freqs);
+		free(trie->freq_max);
+	}
+
+	trie->nodes = NULL;
+	trie->kids = NULL;
+	trie->freqs = NULL;
+	trie->freq_max = NULL;
+}
+
+/******************************************************************************
+ * This function replaces the nodes of a trie with the ones of another trie,
+ * built on the side, and frees the other trie structure.
+ *
+ * @param trie - A pointer to the trie data structure.
+ * @param other - A pointer to the trie whose arenas are taken.
+ *****************************************************************************/
+void trie_take_arenas(trie_t *trie, trie_t *other)
+{
+	trie_release_arenas(trie);
+
+	trie->root = other->root;
+	trie->nodes = other->nodes;
+	trie->nodes_used = other->nodes_used;
+	trie->nodes_cap = other->nodes_cap;
+	trie->free_list = other->free_list;
+	trie->kids = other->kids;
+	trie->kids_used = other->kids_used;
+	trie->kids_cap = other->kids_cap;
+	memcpy(trie->kids_free, other->kids_free, sizeof(trie->kids_free));
+	trie->nnodes = other->nnodes;
+	trie->dead_nodes = other->dead_nodes;
+
+	free(other);
+}
+
+/******************************************************************************
+ * This function prepares a trie for a change: a frozen trie is thawed, the
+ * arenas of a snapshot are copied out of the read-only mapping and the
+ * double array, which cannot follow the change, is dropped.
+ *
+ * @param trie - A pointer to the trie data structure.
+ *****************************************************************************/
+void trie_make_writable(trie_t *trie)
+{
+	if (trie->datrie)
+		datrie_free(&trie->datrie);
+
+	if (trie->frozen) {
+		dawg_thaw(trie);
+		return;
+	}
+	if (!trie->image)
+		return;
+
+	trie_node_t *nodes = malloc(trie->nodes_cap * sizeof(trie_node_t));
+	DIE(!nodes, "Failed to copy the trie node arena");
+	memcpy(nodes, trie->nodes, trie->nodes_used * sizeof(trie_node_t));
+
+	u32 *kids = malloc(trie->kids_cap * sizeof(u32));
+	DIE(!kids, "Failed to copy the trie child pool");
+	memcpy(kids, trie->kids, trie->kids_used * sizeof(u32));
+
+	trie_release_arenas(trie);
+	trie->nodes = nodes;
+	trie->kids = kids;
+}
+
+/******************************************************************************
+ * This function returns the number of bytes used by a trie.
+ *
+ * @param trie - A pointer to the trie data structure.
+ *
+ * @return bytes - The size of the trie structure, its node arena, its child
+ *                 pool and, when it is frozen, its frequency tables.
+ *****************************************************************************/
+size_t trie_memory_usage(trie_t *trie)
+{
+	size_t bytes = sizeof(trie_t) +
+				   (size_t)trie->nodes_cap * sizeof(trie_node_t) +
+				   (size_t)trie->kids_cap * sizeof(u32);
+
+	if (trie->frozen)
+		bytes += (size_t)trie->nwords * (sizeof(int) + 2 * sizeof(u32));
+
+	return bytes;
+}
+
+/******************************************************************************
+ * This function prints how much memory the trie uses and how many bytes are
+ * spent for every distinct word stored in it.
+ *
+ * @param trie - A pointer to the trie data structure.
+ *****************************************************************************/
+void trie_memory_report(trie_t *trie)
+{
+	size_t bytes = trie_memory_usage(trie);
+
+	io_printf(trie->out,
+			  "nodes: %d, words: %d, bytes: %zu, bytes/word: %.2f\n",
+			  trie->nnodes, trie->nwords, bytes,
+			  trie->nwords ? (double)bytes / trie->nwords : 0.0);
+
+	// The nodes left by REMOVE, until the next compaction
+	if (trie->dead_nodes > 0)
+		io_printf(trie->out, "nodes without words: %d\n", trie->dead_nodes);
+
+	// The double array is reported on its own line
+	if (trie->datrie) {
+		bytes = datrie_memory_usage(trie->datrie);
+		io_printf(trie->out, "datrie states: %u, cells: %u, bytes: %zu\n",
+				  trie->datrie->nstates, trie->datrie->ncells, bytes);
+	}
+
+	// The delete-variant index is reported on its own line
+	if (trie->symspell) {
+		bytes = symspell_memory_usage(trie->symspell);
+		io_printf(trie->out,
+				  "symspell variants: %u, bytes: %zu, bytes/word: %.2f\n",
+				  trie->symspell->used_slots, bytes,
+				  trie->nwords ? (double)bytes / trie->nwords : 0.0);
+	}
+
+	// So is the word store, with the kernel of its scans
+	if (trie->wordstore) {
+		bytes = wordstore_memory_usage(trie->wordstore);
+		io_printf(trie->out,
+				  "word store words: %u, bytes: %zu, kernel: %s\n",
+				  trie->wordstore->nwords, bytes, wordstore_kernel_name());
+	}
+}
+
+/******************************************************************************
+ * This function adds all the words of a subtree to the delete-variant index
+ * or to the word store.
+ *
+ * @param trie - A pointer to the trie data structure.
+ * @param node - The index of the root of the subtree.
+ * @param word - The letters of the path to the node.
+ * @param level - The length of the path.
+ * @param symspell - The index that gets the words, or NULL.
+ * @param store - The word store that gets the words, or NULL.
+ *****************************************************************************/
+static void trie_index_words(trie_t *trie, u32 node, char *word,
+							 int level, symspell_t *symspell,
+							 wordstore_t *store)
+{
+	u8 letters[TRIE_MAX_ALPHABET];
+	u32 children[TRIE_MAX_ALPHABET];
+	int n = trie_children(trie, node, letters, children);
+
+	if (trie->nodes[node].end_of_word != 0) {
+		if (symspell)
+			symspell_add(symspell, word, level);
+		if (store)
+			wordstore_add(store, word, level);
+	}
+
+	for (int i = 0; i < n; i++) {
+		word[level] = trie->alphabet[letters[i]];
+		trie_index_words(trie, children[i], word, level + 1, symspell,
+						 store);
+	}
+}
+
+/******************************************************************************
+ * This function converts the value of an option that is a number.
+ *
+ * @param value - The value.
+ *
+ * @return number - The number, -1 if it is negative or not a number.
+ *****************************************************************************/
+static int trie_option_number(const char *value)
+{
+	int number = atoi(value);
+
+	// atoi also gives 0 for a value that is not a number
+	if (number < 0 || (number == 0 && strcmp(value, "0") != 0))
+		return -1;
+	return number;
+}
+
+/******************************************************************************
+ * This function changes the AUTOCORRECT engine (SET engine <value>).
+ *
+ * @param trie - A pointer to the trie data structure.
+ * @param value - "trie" or "symspell", see trie_set_option.
+ *
+ * @return result - 0 if the engine was changed, -1 if it is not valid.
+ *****************************************************************************/
+static int trie_set_engine(trie_t *trie, char *value)
+{
+	if (strcmp(value, "trie") == 0) {
+		if (trie->symspell)
+			symspell_free(&trie->symspell);
+		return 0;
+	}
+	if (strcmp(value, "symspell") == 0) {
+		char word[MAX_STRING_SIZE];
+
+		if (!trie->symspell) {
+			trie->symspell = symspell_create();
+			trie_index_words(trie, trie->root, word, 0, trie->symspell,
+							 NULL);
+		}
+		return 0;
+	}
+
+	return -1;
+}
+
+/******************************************************************************
+ * This function changes the alphabet (SET alphabet <value>), which is only
+ * possible while the trie has no words.
+ *
+ * @param trie - A pointer to the trie data structure.
+ * @param value - The symbols of the alphabet.
+ *
+ * @return result - 0 if the alphabet was changed, -1 otherwise.
+ *****************************************************************************/
+static int trie_change_alphabet(trie_t *trie, char *value)
+{
+	// The branches that REMOVE left go away with the last word
+	if (trie->nwords == 0 && trie->dead_nodes > 0)
+		trie_compact(trie);
+
+	// The letters of the nodes are indices in the old alphabet, and the
+	// readers of the concurrent mode keep a copy of it
+	if (trie->nodes[trie->root].n_children != 0 || trie->frozen ||
+		trie->image || trie->concurrent)
+		return -1;
+	if (trie->datrie)
+		datrie_free(&trie->datrie);
+	if (trie->cache)
+		cache_clear(trie->cache);
+	return trie_set_alphabet(trie, value, strlen(value));
+}
+
+/******************************************************************************
+ * This function changes an option of the trie at runtime.
+ *
+ * @param trie - A pointer to the trie data structure.
+ * @param option - The name of the option:
+ *      - engine: the AUTOCORRECT engine, "trie" (the DFS) or "symspell" (the
+ *                delete-variant index, built from the words of the trie and
+ *                kept up to date by INSERT and REMOVE).
+ *      - backend: the structure walked by the prefix searches, "nodes" (the
+ *                 children of the nodes) or "datrie" (a double array built
+ *                 from the trie, until its next change).
+ *      - threads: the number of threads that count the words of a LOAD, from
+ *                 1 to WORDCOUNT_MAX_THREADS.
+ *      - alphabet: the symbols that form the words, at most
+ *                  TRIE_MAX_ALPHABET of them, while the trie is empty.
+ *      - cache: the number of query results kept by the cache, 0 to
+ *               disable it.
+ *      - compact: the percentage of nodes without words at which REMOVE
+ *                 compacts the trie, 0 to only compact on COMPACT.
+ *      - scan: the smallest tolerance of AUTOCORRECT answered by the scan
+ *              of the word store, "off" to always use the trie.
+ *      - simd: the kernel of the scans, "avx2", "sse2" or "scalar".
+ * @param value - The new value of the option.
+ *
+ * @return result - 0 if the option was changed, -1 if it is not valid.
+ *****************************************************************************/
+int trie_set_option(trie_t *trie, char *option, char *value)
+{
+	if (strcmp(option, "engine") == 0)
+		return trie_set_engine(trie, value);
+
+	if (strcmp(option, "backend") == 0) {
+		if (strcmp(value, "nodes") == 0) {
+			if (trie->datrie)
+				datrie_free(&trie->datrie);
+			return 0;
+		}
+		if (strcmp(value, "datrie") == 0) {
+			if (!trie->datrie)
+				trie->datrie = datrie_build(trie);
+			return 0;
+		}
+	}
+
+	if (strcmp(option, "threads") == 0) {
+		int threads = atoi(value);
+
+		if (threads < 1 || threads > WORDCOUNT_MAX_THREADS)
+			return -1;
+		trie->load_threads = threads;
+		return 0;
+	}
+
+	if (strcmp(option, "alphabet") == 0)
+		return trie_change_alphabet(trie, value);
+
+	if (strcmp(option, "compact") == 0) {
+		int percent = trie_option_number(value);
+
+		if (percent < 0 || percent > 100)
+			return -1;
+		trie->compact_percent = percent;
+		return 0;
+	}
+
+	if (strcmp(option, "scan") == 0) {
+		int distance = trie_option_number(value);
+
+		// Without the scans the store is not kept up to date any more
+		if (strcmp(value, "off") == 0) {
+			if (trie->wordstore)
+				wordstore_free(&trie->wordstore);
+			trie->scan_distance = -1;
+			return 0;
+		}
+		if (distance < 0)
+			return -1;
+		trie->scan_distance = distance;
+		return 0;
+	}
+
+	if (strcmp(option, "simd") == 0)
+		return wordstore_set_kernel(value);
+
+	if (strcmp(option, "cache") == 0) {
+		int entries = trie_option_number(value);
+
+		if (entries < 0)
+			return -1;
+		if (trie->cache)
+			cache_free(&trie->cache);
+		if (entries > 0)
+			trie->cache = cache_create(entries);
+		return 0;
+	}
+
+	return -1;
+}
+
+/*
+ * The commands of mk and their codes, up to an empty name. which_command
+ * finds them through a perfect hash: a seed with which no two names share a
+ * slot of the table.
+ */
+static const struct {
+	const char *name;
+	int code;
+} trie_commands[] = {
+	{"LOAD", LOAD}, {"INSERT", INSERT}, {"REMOVE", REMOVE}, {"EXIT", EXIT},
+	{"AUTOCORRECT", AUTOCORRECT}, {"AUTOCOMPLETE", AUTOCOMPLETE},
+	{"MEMORY", MEMORY}, {"SET", SET}, {"LOADFREQ", LOADFREQ},
+	{"FREEZE", FREEZE}, {"SAVE", SAVE}, {"OPEN", OPEN}, {"BATCH", BATCH},
+	{"CACHE", CACHE}, {"STATS", STATS}, {"COMPACT", COMPACT}, {NULL, -1}
+};
+
+/******************************************************************************
+ * This function computes the slot of a command name in the table of the
+ * perfect hash.
+ *
+ * @param command - The name of the command.
+ * @param seed - The seed of the hash.
+ *
+ * @return slot - The slot of the name, below TRIE_COMMAND_SLOTS.
+ *****************************************************************************/
+static u32 trie_command_slot(const char *command, u32 seed)
+{
+	u32 hash = 2166136261u ^ (seed * 2654435761u);
+
+	for (; *command; command++)
+		hash = (hash ^ (u8)*command) * 16777619u;
+
+	return (hash >> 16) & (TRIE_COMMAND_SLOTS - 1);
+}
+
+/******************************************************************************
+ * This function compares the command read from the keyboard with the commands
+ * preset by mk. The first call looks for a seed of the hash that gives every
+ * command its own slot, then a command costs one hash and one strcmp.
+ *
+ * @param command - The command read from the keyboard.
+ *
+ * @return code - The code of the command, -1 if it is not preset.
+ *****************************************************************************/
+int which_command(char *command)
+{
+	static s8 table[TRIE_COMMAND_SLOTS];
+	static u32 seed;
+	static int ready;
+
+	if (!ready) {
+		int i = 0;
+
+		// Try the seeds until no two commands share a slot
+		while (trie_commands[i].name) {
+			seed++;
+			memset(table, -1, sizeof(table));
+			for (i = 0; trie_commands[i].name; i++) {
+				u32 slot = trie_command_slot(trie_commands[i].name, seed);
+
+				if (table[slot] != -1)
+					break;
+				table[slot] = i;
+			}
+		}
+		ready = 1;
+	}
+
+	// The only name that may be in the slot of the command
+	int i = table[trie_command_slot(command, seed)];
+
+	if (i >= 0 && strcmp(command, trie_commands[i].name) == 0)
+		return trie_commands[i].code;
+
+	// If the command is not preset, we return -1
+	return -1;
+}
+
+/******************************************************************************
+ * This function inserts in a trie all the words that are in the file given as
+ * a parameter.
+ *
+ * The file is mapped in memory and split into one part per thread
+ * (load_threads). Every thread scans its part with the tokenizer table of
+ * the trie (the letters of the alphabet, in any case, form the words and
+ * every other byte is a separator) and counts the words in its own hash
+ * table. Then every distinct word goes into the trie once, straight from the
+ * mapping, with its number of occurrences. The words too long for the trie
+ * (MAX_STRING_SIZE) are skipped.
+ *
+ * @param trie - A pointer to the trie data structure.
+ * @param filename - The name of the file that contains the words.
+ *****************************************************************************/
+void trie_load(trie_t *trie, char *filename)
+{
+	wordcount_t tables[WORDCOUNT_MAX_THREADS];
+	struct stat info;
+
+	// Open the file
+	int fd = open(filename, O_RDONLY);
+	DIE(fd < 0, "Failed to open file");
+	DIE(fstat(fd, &info) < 0, "Failed to stat file");
+
+	// An empty file has no words and cannot be mapped
+	if (info.st_size == 0) {
+		close(fd);
+		return;
+	}
+
+	// Map the whole file
+	char *map = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	DIE(map == MAP_FAILED, "Failed to map file");
+	close(fd);
+
+	// Count the words of every part of the file
+	int n = wordcount_scan(map, info.st_size, trie->fold, MAX_STRING_SIZE - 1,
+						   trie->load_threads, tables);
+
+	// Merge the counts into the trie
+	for (int i = 0; i < n; i++) {
+		for (u32 j = 0; j < tables[i].nslots; j++) {
+			wordcount_entry_t *entry = &tables[i].slots[j];
+
+			if (entry->word)
+				trie_insert_token(trie, entry->word, entry->len,
+								  entry->count);
+		}
+		wordcount_free(&tables[i]);
+	}
+
+	munmap(map, info.st_size);
+}
+
+/******************************************************************************
+ * This function sets the frequency of the word that ends in a node, keeping
+ * the counters of the trie and the delete-variant index up to date.
+ *
+ * @param trie - A pointer to the trie data structure.
+ * @param node - The index of the node where the word ends.
+ * @param word - The letters of the word, as indices in the alphabet.
+ * @param len - The length of the word.
+ * @param count - The new frequency of the word.
+ *****************************************************************************/
+static void trie_set_frequency(trie_t *trie, u32 node, u8 *word,
+							   int len, int count)
+{
+	if (trie->nodes[node].end_of_word == 0) {
+		trie->nwords++;
+		if (trie->symspell || trie->wordstore) {
+			char letters[MAX_STRING_SIZE];
+
+			for (int i = 0; i < len; i++)
+				letters[i] = trie->alphabet[word[i]];
+			if (trie->symspell)
+				symspell_add(trie->symspell, letters, len);
+			if (trie->wordstore)
+				wordstore_add(trie->wordstore, letters, len);
+		}
+	}
+
+	trie->size += count - trie->nodes[node].end_of_word;
+	trie->nodes[node].end_of_word = count;
+}
+
+/******************************************************************************
+ * This function parses a line of a list of words with their frequencies.
+ *
+ * @param trie - A pointer to the trie data structure.
+ * @param p - The start of the line.
+ * @param line_end - The end of the line, without the newline.
+ * @param word - A pointer to where the start of the word is written.
+ * @param count - A pointer to where the count of the word is written.
+ *
+ * @return len - The length of the word, -1 if the line is not a valid
+ *               "word count" pair: the word has a character outside of the
+ *               alphabet, is too long or has no positive count.
+ *****************************************************************************/
+static int trie_freq_line(trie_t *trie, const char *p, const char *line_end,
+						  const char **word, int *count)
+{
+	long long number = 0;
+	int len, blanks;
+
+	// The word, up to the first blank
+	while (p < line_end && isspace((unsigned char)*p))
+		p++;
+	*word = p;
+	while (p < line_end && trie->fold[(unsigned char)*p])
+		p++;
+	len = p - *word;
+
+	// Then its count, after at least one blank
+	while (p < line_end && (*p == ' ' || *p == '\t'))
+		p++;
+	blanks = p > *word + len;
+	while (p < line_end && *p >= '0' && *p <= '9' && number <= INT32_MAX)
+		number = number * 10 + (*p++ - '0');
+	while (p < line_end && isspace((unsigned char)*p))
+		p++;
+
+	if (p != line_end || !blanks || len == 0 || len >= MAX_STRING_SIZE ||
+		number <= 0 || number > INT32_MAX)
+		return -1;
+	*count = number;
+
+	return len;
+}
+
+/******************************************************************************
+ * This function adds the words of a list with their frequencies to the trie,
+ * see trie_load_freq.
+ *
+ * @param trie - A pointer to the trie data structure, writable.
+ * @param p - The start of the list.
+ * @param end - The end of the list.
+ *****************************************************************************/
+static void trie_build_freq(trie_t *trie, const char *p, const char *end)
+{
+	// The nodes and the letters of the previous word
+	u32 path[MAX_STRING_SIZE];
+	u8 word[MAX_STRING_SIZE];
+	int depth = 0;
+
+	path[0] = trie->root;
+	while (p < end) {
+		const char *start, *line_end = memchr(p, '\n', end - p);
+		int count, len, common = 0;
+
+		if (!line_end)
+			line_end = end;
+
+		// Skip the lines that are not a valid "word count" pair
+		len = trie_freq_line(trie, p, line_end, &start, &count);
+		p = line_end < end ? line_end + 1 : end;
+		if (len < 0)
+			continue;
+
+		// Keep the prefix shared with the previous word
+		while (common < depth && common < len &&
+			   word[common] == trie->fold[(unsigned char)start[common]] - 1)
+			common++;
+
+		// The rest of the previous word will not be visited again
+		while (depth > common)
+			trie_update_summary(trie, path[depth--]);
+
+		// Descend with the rest of the word, creating the missing nodes
+		for (; depth < len; depth++) {
+			int letter = trie->fold[(unsigned char)start[depth]] - 1;
+			u32 next = trie_child(trie, path[depth], letter);
+
+			if (next == TRIE_NIL) {
+				next = trie_create_node(trie);
+				trie_set_child(trie, path[depth], letter, next);
+				trie->nnodes++;
+			}
+			word[depth] = letter;
+			path[depth + 1] = next;
+		}
+
+		trie_set_frequency(trie, path[depth], word, len, count);
+	}
+
+	// Finish the last word, up to the root
+	while (depth >= 0)
+		trie_update_summary(trie, path[depth--]);
+}
+
+/******************************************************************************
+ * This function builds the trie from a list of words with their frequencies,
+ * one "word count" pair on every line, sorted by word. The frequency of every
+ * word in the list is set to its count.
+ *
+ * The file is read in one pass. The nodes of the previous word stay on a
+ * stack, so a word only descends from the end of the prefix it shares with
+ * the previous one. The summaries of a node are computed once, when it leaves
+ * the stack: in a sorted list, no later word goes through it again. The build
+ * is linear in the number of characters. An unsorted list gives the same
+ * trie, it only shares shorter prefixes.
+ *
+ * The lines whose word has a character outside of the alphabet, is too long
+ * or has no positive count are skipped.
+ *
+ * @param trie - A pointer to the trie data structure.
+ * @param filename - The name of the file that contains the list.
+ *****************************************************************************/
+void trie_load_freq(trie_t *trie, char *filename)
+{
+	struct stat info;
+
+	// The bulk load changes the nodes in place, which the readers of the
+	// concurrent mode cannot follow
+	if (trie->concurrent)
+		return;
+
+	// The frequencies change in place, without new generations
+	if (trie->cache)
+		cache_clear(trie->cache);
+
+	// Open the file
+	int fd = open(filename, O_RDONLY);
+	DIE(fd < 0, "Failed to open file");
+	DIE(fstat(fd, &info) < 0, "Failed to stat file");
+
+	// An empty file has no words and cannot be mapped
+	if (info.st_size == 0) {
+		close(fd);
+		return;
+	}
+
+	// Map the whole file
+	char *map = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	DIE(map == MAP_FAILED, "Failed to map file");
+	close(fd);
+
+	// A frozen or mapped trie cannot be changed in place
+	trie_make_writable(trie);
+
+	trie_build_freq(trie, map, map + info.st_size);
+
+	munmap(map, info.st_size);
+
+	// The words may have gone through the branches that REMOVE left, which
+	// are not counted one by one: the ones still empty are reclaimed
+	if (trie->dead_nodes > 0)
+		trie_compact(trie);
+}
+
+/******************************************************************************
+ * This function checks, using the length mask of a node, if its subtree may
+ * hold a word that ends a given number of levels below it.
+ *
+ * @param node - A pointer to the node.
+ * @param len - The number of levels below the node.
+ *
+ * @return result - 0 if there is no such word, 1 if there may be one.
+ *****************************************************************************/
+int trie_has_length(trie_node_t *node, int len)
+{
+	if (len < 0)
+		return 0;
+	if (len >= TRIE_MASK_LENGTHS - 1)
+		return (node->len_mask >> (TRIE_MASK_LENGTHS - 1)) & 1;
+	return (node->len_mask >> len) & 1;
+}
+
+/******************************************************************************
+ * This function converts a query word to the indices of its letters, so that
+ * the searches compare it to the letters of the nodes directly.
+ *
+ * @param trie - A pointer to the trie data structure.
+ * @param word - The query word.
+ * @param len - The length of the word.
+ * @param letters - Buffer for the indices. A character outside of the
+ *                  alphabet gets TRIE_NONE, which matches no letter.
+ *****************************************************************************/
+static void trie_query_letters(trie_t *trie, const char *word, int len,
+							   u8 *letters)
+{
+	for (int i = 0; i < len; i++) {
+		int letter = trie->fold[(unsigned char)word[i]] - 1;
+
+		letters[i] = letter < 0 ? TRIE_NONE : letter;
+	}
+}
+
+/******************************************************************************
+ * This function performs depth-first search (DFS) for autocorrect in a trie.
+ * The mismatches are counted while descending, so a branch is abandoned as
+ * soon as it has more than k of them, and the subtrees without any word of
+ * the length of the input word are skipped.
+ *
+ * @param trie: Pointer to the trie structure
+ * @param node: The index of the trie node
+ * @param word: The letters of the word to autocorrect, as indices
+ * @param len: The length of the word
+ * @param k: The maximum number of allowed differences between words
+ * @param trie_word: The current word formed in the trie traversal
+ * @param level: The current level of the trie traversal
+ * @param mismatches: The differences between the word and the current path
+ * @param ok: Pointer to a flag indicating if an autocorrected word was found
+ *****************************************************************************/
+void DFS_autocorrect(trie_t *trie, u32 node, u8 *word, int len,
+					 int k, char *trie_word, int level, int mismatches, int *ok)
+{
+	// Only the words with the same length as the input word are valid
+	if (level == len) {
+		if (trie->nodes[node].end_of_word != 0) {
+			*ok = 1;
+			io_write_line(trie->out, trie_word, len);
+		}
+		return;
+	}
+
+	// If the node has children, we continue the DFS
+	u8 letters[TRIE_MAX_ALPHABET];
+	u32 children[TRIE_MAX_ALPHABET];
+	int n = trie_children(trie, node, letters, children);
+
+	for (int i = 0; i < n; i++) {
+		int count = mismatches + (letters[i] != word[level]);
+
+		// Skip the child if it differs too much or lacks the length
+		if (count > k ||
+			!trie_has_length(&trie->nodes[children[i]], len - level - 1))
+			continue;
+
+		// We add the current letter to the trie_word
+		trie_word[level] = trie->alphabet[letters[i]];
+
+		// We continue the DFS
+		DFS_autocorrect(trie, children[i], word, len, k, trie_word,
+						level + 1, count, ok);
+	}
+}
+
+/******************************************************************************
+ * This function performs autocorrect on a trie.
+ *
+ * @param trie: Pointer to the trie structure
+ * @param word: The input word to autocorrect
+ * @param k: The maximum number of allowed differences between words
+ *****************************************************************************/
+void trie_autocorrect(trie_t *trie, char *word, int k)
+{
+	u8 letters[MAX_STRING_SIZE];
+	char trie_word[MAX_STRING_SIZE];
+	int len = strlen(word);
+	int ok = 0;
+
+	// A repeated query is answered by the cache
+	if (cache_begin(trie, CACHE_AUTOCORRECT, word, k))
+		return;
+	STATS_ADD(trie, autocorrect, 1);
+	STATS_START(trie, autocorrect_nodes, nodes);
+
+	// No word of the trie is that long
+	if (len >= MAX_STRING_SIZE)
+		len = -1;
+	else
+		trie_query_letters(trie, word, len, letters);
+
+	// The delete-variant index answers the small tolerances, if enabled,
+	// and the word store the big ones, that the DFS cannot prune much. They
+	// hold the words as they are stored, so the query is folded the same
+	int index = len >= 0 && trie->symspell && k <= SYMSPELL_MAX_DISTANCE;
+	int scan = len >= 0 && !index && trie->scan_distance >= 0 &&
+			   k >= trie->scan_distance;
+
+	if (index || scan) {
+		for (int i = 0; i < len; i++)
+			if (letters[i] != TRIE_NONE)
+				trie_word[i] = trie->alphabet[letters[i]];
+			else
+				trie_word[i] = word[i];
+		trie_word[len] = '\0';
+	}
+
+	if (index) {
+		ok = symspell_autocorrect(trie->symspell, trie_word, k,
+								  trie->out) != 0;
+	} else if (scan) {
+		// The store is filled by the first scan, then kept up to date
+		if (!trie->wordstore) {
+			char path[MAX_STRING_SIZE];
+
+			trie->wordstore = wordstore_create();
+			trie_index_words(trie, trie->root, path, 0, NULL,
+							 trie->wordstore);
+		}
+		STATS_ADD(trie, scan, 1);
+		if (len < trie->wordstore->nbuckets)
+			STATS_ADD(trie, scan_words, trie->wordstore->buckets[len].n);
+		ok = wordstore_autocorrect(trie->wordstore, trie_word, len, k,
+								   trie->out) != 0;
+	// Otherwise, we call the DFS function
+	} else if (trie_has_length(&trie->nodes[trie->root], len)) {
+		DFS_autocorrect(trie, trie->root, letters, len, k, trie_word,
+						0, 0, &ok);
+	}
+
+	// If the word is not valid, we print "No words found"
+	if (ok == 0)
+		io_write_line(trie->out, "No words found", 14);
+
+	STATS_STOP(trie, autocorrect_nodes, nodes);
+	cache_end(trie);
+}
+
+/******************************************************************************
+ * This function performs depth-first search (DFS) for autocorrect by edit
+ * distance. Every level of the trie adds one row of the Levenshtein matrix
+ * between the word and the letters of the current path, computed from the
+ * row of the parent, and a subtree is abandoned as soon as every value of
+ * its row is bigger than the tolerance.
+ *
+ * @param trie: Pointer to the trie structure
+ * @param node: The index of the trie node
+ * @param word: The letters of the word to autocorrect, as indices
+ * @param len: The length of the word
+ * @param k: The maximum edit distance between the words
+ * @param rows: The rows of the Levenshtein matrix, one for every level
+ * @param trie_word: The current word formed in the trie traversal
+ * @param level: The current level of the trie traversal
+ * @param ok: Pointer to a flag indicating if an autocorrected word was found
+ *****************************************************************************/
+void DFS_levenshtein(trie_t *trie, u32 node, u8 *word, int len,
+					 int k, int *rows, char *trie_word, int level, int *ok)
+{
+	int *row = rows + level * (len + 1);
+
+	// If the whole word is within the tolerance, we print it
+	if (trie->nodes[node].end_of_word != 0 && row[len] <= k) {
+		*ok = 1;
+		io_write_line(trie->out, trie_word, level);
+	}
+
+	u8 letters[TRIE_MAX_ALPHABET];
+	u32 children[TRIE_MAX_ALPHABET];
+	int n = trie_children(trie, node, letters, children);
+
+	for (int i = 0; i < n; i++) {
+		int *next = row + len + 1;
+		int min;
+
+		// A branch that REMOVE left without words has nothing to print
+		if (trie->nodes[children[i]].nwords == 0)
+			continue;
+
+		// We add the current letter to the trie_word
+		trie_word[level] = trie->alphabet[letters[i]];
+
+		// The row of the child: deletion, insertion or substitution
+		next[0] = level + 1;
+		min = next[0];
+		for (int j = 1; j <= len; j++) {
+			int cost = row[j - 1] + (word[j - 1] != letters[i]);
+
+			if (row[j] + 1 < cost)
+				cost = row[j] + 1;
+			if (next[j - 1] + 1 < cost)
+				cost = next[j - 1] + 1;
+			next[j] = cost;
+			if (cost < min)
+				min = cost;
+		}
+
+		// The distance can only grow below the child, so we prune it
+		if (min <= k)
+			DFS_levenshtein(trie, children[i], word, len, k, rows,
+							trie_word, level + 1, ok);
+	}
+}
+
+/******************************************************************************
+ * This function performs autocorrect on a trie by edit distance, so the
+ * words may also differ from the input word by inserted or deleted letters.
+ *
+ * @param trie: Pointer to the trie structure
+ * @param word: The input word to autocorrect
+ * @param k: The maximum edit distance between the words
+ *****************************************************************************/
+void trie_autocorrect_edit(trie_t *trie, char *word, int k)
+{
+	int len = strlen(word);
+	int ok = 0;
+
+	// The words are shorter than MAX_STRING_SIZE, so they are all more than
+	// len - MAX_STRING_SIZE away from the word
+	if (k < 0 || len - k >= MAX_STRING_SIZE) {
+		io_write_line(trie->out, "No words found", 14);
+		return;
+	}
+
+	// No distance is larger than max(len, MAX_STRING_SIZE), so a larger k
+	// finds the same words
+	if (k > (len > MAX_STRING_SIZE ? len : MAX_STRING_SIZE))
+		k = len > MAX_STRING_SIZE ? len : MAX_STRING_SIZE;
+
+	// A repeated query is answered by the cache
+	if (cache_begin(trie, CACHE_EDIT, word, k))
+		return;
+	STATS_ADD(trie, edit, 1);
+	STATS_START(trie, edit_nodes, nodes);
+
+	// A word within the tolerance has at most len + k letters, and the trie
+	// is less than MAX_STRING_SIZE letters deep
+	size_t levels = (size_t)len + k;
+
+	if (levels > MAX_STRING_SIZE)
+		levels = MAX_STRING_SIZE;
+	levels += 2;
+	int *rows = malloc(levels * (len + 1) * sizeof(int));
+	DIE(!rows, "Failed to allocate memory for the Levenshtein rows");
+
+	char *trie_word = malloc(levels);
+	DIE(!trie_word, "Failed to allocate memory for trie_word");
+
+	u8 *letters = malloc(len + 1);
+	DIE(!letters, "Failed to allocate memory for the letters of the word");
+	trie_query_letters(trie, word, len, letters);
+
+	// The row of the root: the distance to every prefix of the word
+	for (int j = 0; j <= len; j++)
+		rows[j] = j;
+
+	// We call the DFS function
+	DFS_levenshtein(trie, trie->root, letters, len, k, rows, trie_word, 0,
+					&ok);
+
+	// If no word is close enough, we print "No words found"
+	if (ok == 0)
+		io_write_line(trie->out, "No words found", 14);
+
+	STATS_STOP(trie, edit_nodes, nodes);
+	STATS_ADD(trie, bytes, levels * (len + 1) * sizeof(int) + levels +
+			  len + 1);
+
+	free(rows);
+	free(trie_word);
+	free(letters);
+	cache_end(trie);
+}
+
+/******************************************************************************
+ * This function walks the trie along a prefix.
+ *
+ * @param trie - A pointer to the trie data structure.
+ * @param prefix - The prefix to match.
+ *
+ * @return node - The index of the node of the prefix, TRIE_NIL if no word
+ *                starts with the prefix.
+ *****************************************************************************/
+u32 trie_find_prefix(trie_t *trie, char *prefix)
+{
+	u32 node = trie->root;
+
+	// The double array needs two array reads for every letter
+	if (trie->datrie) {
+		STATS_ADD(trie, nodes, strlen(prefix));
+		return datrie_find_prefix(trie->datrie, trie->fold, prefix);
+	}
+
+	for (int i = 0; prefix[i] && node != TRIE_NIL; i++) {
+		int letter = trie->fold[(unsigned char)prefix[i]] - 1;
+
+		if (letter < 0)
+			return TRIE_NIL;
+		node = trie_child(trie, node, letter);
+	}
+
+	return node;
+}
+
+/******************************************************************************
+ * This function returns the summary direction of a node for an autocomplete
+ * task.
+ *
+ * @param node - A pointer to the node.
+ * @param task - 1 for the lexicographically smallest word, 2 for the shortest
+ *               word, 3 for the word with the highest frequency.
+ *
+ * @return dir - The letter to follow, TRIE_SELF or TRIE_NONE.
+ *****************************************************************************/
+static int trie_summary_dir(trie_node_t *node, int task)
+{
+	if (task == 1)
+		return node->lex_dir;
+	if (task == 2)
+		return node->short_dir;
+	return node->freq_dir;
+}
+
+/******************************************************************************
+ * This function finds the best completion of a prefix for a task, by
+ * following the summaries from the node of the prefix down to the word.
+ *
+ * @param trie - A pointer to the trie data structure.
+ * @param node - The index of the node of the prefix, or TRIE_NIL.
+ * @param prefix - The prefix to match.
+ * @param task - The autocomplete task (1, 2 or 3).
+ * @param word - Buffer of MAX_STRING_SIZE bytes for the completion.
+ *
+ * @return len - The length of the completion, -1 if no word starts with the
+ *               prefix.
+ *****************************************************************************/
+static int trie_completion(trie_t *trie, u32 node, char *prefix,
+						   int task, char *word)
+{
+	int len = strlen(prefix);
+
+	// The frequencies of a frozen trie are not in its nodes
+	if (task == 3 && trie->frozen)
+		return dawg_autocomplete_frequent(trie, prefix, word);
+
+	if (node == TRIE_NIL ||
+		trie_summary_dir(&trie->nodes[node], task) == TRIE_NONE)
+		return -1;
+
+	// Append the letters given by the summaries until the word ends
+	memcpy(word, prefix, len);
+	for (int dir = trie_summary_dir(&trie->nodes[node], task);
+		 dir != TRIE_SELF; dir = trie_summary_dir(&trie->nodes[node], task)) {
+		word[len++] = trie->alphabet[dir];
+		node = trie_child(trie, node, dir);
+	}
+	STATS_ADD(trie, letters, len);
+
+	return len;
+}
+
+/******************************************************************************
+ * This function prints the best completion of a prefix for a task.
+ *
+ * @param trie - A pointer to the trie data structure.
+ * @param node - The index of the node of the prefix, or TRIE_NIL.
+ * @param prefix - The prefix to match.
+ * @param task - The autocomplete task (1, 2 or 3).
+ *****************************************************************************/
+static void print_completion(trie_t *trie, u32 node, char *prefix,
+							 int task)
+{
+	char word[MAX_STRING_SIZE];
+	int len = trie_completion(trie, node, prefix, task, word);
+
+	if (len < 0)
+		io_write_line(trie->out, "No words found", 14);
+	else
+		io_write_line(trie->out, word, len);
+}
+
+/******************************************************************************
+ * This function prints the results of an AUTOCOMPLETE whose prefix was
+ * already walked.
+ *
+ * @param trie - A pointer to the trie data structure.
+ * @param node - The index of the node of the prefix, or TRIE_NIL.
+ * @param prefix - The prefix, as it is stored.
+ * @param k - The task, see trie_autocomplete.
+ *****************************************************************************/
+static void trie_autocomplete_node(trie_t *trie, u32 node, char *prefix,
+								   int k)
+{
+	switch (k) {
+	// If k = 0, we print the results of all the tasks
+	case 0:
+		print_completion(trie, node, prefix, 1);
+		print_completion(trie, node, prefix, 2);
+		print_completion(trie, node, prefix, 3);
+		break;
+
+	// Otherwise, we print the result of the given task
+	case 1:
+	case 2:
+	case 3:
+		print_completion(trie, node, prefix, k);
+		break;
+
+	default:
+		// If the command is not preset, we return
+		break;
+	}
+}
+
+/******************************************************************************
+ * This function performs autocomplete on a trie given a prefix and returns
+ * results based on the specified criteria. Every node keeps the summaries of
+ * its subtree, so the cost only depends on the lengths of the prefix and of
+ * the words printed.
+ *
+ * @param trie - A pointer to the trie data structure.
+ * @param prefix - The prefix to match.
+ * @param k - The criteria for autocomplete results:
+ *      - k = 0: Returns the lexicographically smallest word, the shortest word,
+ *               and the word with the highest frequency.
+ *      - k = 1: Returns the lexicographically smallest word.
+ *      - k = 2: Returns the shortest word.
+ *      - k = 3: Returns the word with the highest frequency.
+*****************************************************************************/
+void trie_autocomplete(trie_t *trie, char *prefix, int k)
+{
+	char word[MAX_STRING_SIZE];
+
+	if (k >= 0 && k <= 3) {
+		STATS_ADD(trie, autocomplete[k], 1);
+		STATS_START(trie, autocomplete_nodes[k], nodes);
+		STATS_START(trie, autocomplete_letters[k], letters);
+	}
 
-	// Return the trie
-	return trie;
+	// The completions start with the prefix as it is stored
+	if (trie_fold_word(trie, prefix, word) >= 0)
+		prefix = word;
+
+	// We walk the prefix only once, for all the tasks
+	trie_autocomplete_node(trie, trie_find_prefix(trie, prefix), prefix, k);
+
+	if (k >= 0 && k <= 3) {
+		STATS_STOP(trie, autocomplete_nodes[k], nodes);
+		STATS_STOP(trie, autocomplete_letters[k], letters);
+	}
 }
 
+/*
+ * State of a fuzzy AUTOCOMPLETE: the letters of the prefix and the rows of
+ * its Levenshtein matrix, one for every level of the walk, and the best
+ * completion found so far for every task.
+ */
+typedef struct trie_fuzzy_t trie_fuzzy_t;
+struct trie_fuzzy_t {
+	u8 *letters;
+	int len;
+	int k;
+	int *rows;
+	char *path;
+	int task;
+	char words[3][MAX_STRING_SIZE];
+	int lens[3];
+	int scores[3];
+};
+
 /******************************************************************************
- * This function inserts a word into the trie.
+ * This function ranks the words below a node of the frontier of a fuzzy
+ * AUTOCOMPLETE against the best completions found so far. The frontier is
+ * reached in lexicographic order, so on equal scores the earlier completion
+ * stays, like the tie rules of the summaries.
  *
  * @param trie - A pointer to the trie data structure.
- * @param key - The word that has to be inserted in the trie.
+ * @param fuzzy - The state of the query.
+ * @param node - The index of the node.
+ * @param level - The length of the path of the node.
  *****************************************************************************/
-void trie_insert(trie_t *trie, char *key)
+static void trie_fuzzy_rank(trie_t *trie, trie_fuzzy_t *fuzzy, u32 node,
+							int level)
 {
-	// Start from the root
-	trie_node_t *node = trie->root;
-
-	// Iterate through the word
-	for (int i = 0; i < (int)(strlen(key)); i++) {
-		// If the current letter is not in the trie, we add it
-		if (node->children[key[i] - 'a'] == NULL) {
-			// Create a new node
-			node->children[key[i] - 'a'] = trie_create_node();
-
-			// Increment the number of children of the current node
-			node->n_children++;
-
-			// Increment the number of nodes in the trie
-			trie->nnodes++;
+	trie_node_t *current = &trie->nodes[node];
+	char word[MAX_STRING_SIZE];
+
+	fuzzy->path[level] = '\0';
+	for (int task = 1; task <= 3; task++) {
+		int i = task - 1, len, score = 0;
+
+		if (fuzzy->task != 0 && fuzzy->task != task)
+			continue;
+
+		// The score to beat: none for the smallest word (the first node
+		// has it), the length for the shortest and the frequency for the
+		// most frequent one, from the summaries. A frozen trie has no
+		// frequencies in its nodes, its word is looked up below.
+		if (task == 2)
+			score = -(level + current->short_len);
+		if (task == 3 && !trie->frozen)
+			score = current->best_freq;
+		if (fuzzy->lens[i] >= 0 && score <= fuzzy->scores[i] &&
+			!(task == 3 && trie->frozen))
+			continue;
+
+		len = trie_completion(trie, node, fuzzy->path, task, word);
+		if (len < 0)
+			continue;
+
+		if (task == 3 && trie->frozen) {
+			u32 rank;
+
+			word[len] = '\0';
+			dawg_find_prefix(trie, word, &rank);
+			score = trie->freqs[rank];
+			if (fuzzy->lens[i] >= 0 && score <= fuzzy->scores[i])
+				continue;
 		}
 
-		// Go to the next node
-		node = node->children[key[i] - 'a'];
+		memcpy(fuzzy->words[i], word, len);
+		fuzzy->lens[i] = len;
+		fuzzy->scores[i] = score;
 	}
-	// Mark the end of the word
-	node->end_of_word++;
-
-	// Increment the size of the trie
-	trie->size++;
 }
 
 /******************************************************************************
- * This function searches for a word in the trie and returns it.
+ * This function tells if the words below a node of a fuzzy AUTOCOMPLETE
+ * can still beat the best completions found so far. They come after them in
+ * lexicographic order, so they would have to be strictly shorter or more
+ * frequent, which the summaries of the node bound.
  *
  * @param trie - A pointer to the trie data structure.
- * @param key - The word that has to be searched in the trie.
+ * @param fuzzy - The state of the query.
+ * @param node - The index of the node.
+ * @param level - The length of the path of the node.
  *
- * @return node - A pointer to the node that contains the word.
+ * @return result - 1 if a task can still get a better completion, 0 if not.
  *****************************************************************************/
-void *trie_search(trie_t *trie, char *key)
+static int trie_fuzzy_promising(trie_t *trie, trie_fuzzy_t *fuzzy,
+								u32 node, int level)
 {
-	// Verify if the word exists
-	if (!key[0])
-		return trie->root;
-
-	// Start from the root
-	trie_node_t *node = trie->root;
-
-	// Iterate through the word
-	for (int i = 0; i < (int)(strlen(key)); i++) {
-		// If the current letter is not in the trie, return NULL
-		if (node->children[key[i] - 'a'] == NULL)
-			return NULL;
-		// Go to the next node
-		node = node->children[key[i] - 'a'];
-	}
-	// If the word exists, return the node
-	if (node->end_of_word != 0)
-		return node;
-	// Otherwise, return NULL
-	return NULL;
+	trie_node_t *current = &trie->nodes[node];
+
+	if ((fuzzy->task == 0 || fuzzy->task == 1) && fuzzy->lens[0] < 0)
+		return 1;
+	if ((fuzzy->task == 0 || fuzzy->task == 2) &&
+		(fuzzy->lens[1] < 0 ||
+		 -(level + current->short_len) > fuzzy->scores[1]))
+		return 1;
+
+	// The frequencies of a frozen trie are not in its nodes
+	if ((fuzzy->task == 0 || fuzzy->task == 3) &&
+		(fuzzy->lens[2] < 0 || trie->frozen ||
+		 current->best_freq > fuzzy->scores[2]))
+		return 1;
+
+	return 0;
 }
 
 /******************************************************************************
- * This function is a helper function used to remove a node from a trie data
- * structure. It is called recursively to remove the nodes associated with the
- * given word.
+ * This function walks the trie for a fuzzy AUTOCOMPLETE. Every node gets the
+ * row of the Levenshtein matrix between its path and the prefix; a node whose
+ * path is within k of the whole prefix is on the frontier, and its words are
+ * ranked without going further down. A branch whose row is all above k is
+ * abandoned, since the distance can only grow below it, and so is a branch
+ * whose summaries cannot beat the completions already found.
+ *
  * @param trie - A pointer to the trie data structure.
- * @param node - A pointer to the current node being processed.
- * @param key - The word that has to be removed from the trie.
- * @param index - The index of the current character in the key being processed.
- **************************************************************************/
-void trie_remove_helper(trie_t *trie, trie_node_t *node, char *key, int index)
+ * @param fuzzy - The state of the query.
+ * @param node - The index of the node.
+ * @param level - The length of the path of the node.
+ *****************************************************************************/
+static void DFS_fuzzy(trie_t *trie, trie_fuzzy_t *fuzzy, u32 node,
+					  int level)
 {
-	// If the index is equal to the length of the key, we reached the end of
-	// the word.
-	if (index == (int)(strlen(key))) {
-		// If there is end_of_word, we remove the word
-		if (node->end_of_word != 0) {
-			node->end_of_word = 0;
-
-			// We decrement the size of the trie
-			trie->size--;
+	int len = fuzzy->len;
+	int *row = fuzzy->rows + level * (len + 1);
 
-			// If the node has no children, we remove it
-			if (node->n_children == 0) {
-				free(node->children);
-				node->children = NULL;
-			}
-		}
-		// Otherwise, we do nothing
+	if (row[len] <= fuzzy->k) {
+		trie_fuzzy_rank(trie, fuzzy, node, level);
 		return;
 	}
 
-	// If the current letter is not in the trie, we return
-	if (node->children[key[index] - 'a'] == NULL)
-		return;
-
-	// We go to the next node
-	trie_remove_helper(trie, node->children[key[index] - 'a'], key, index + 1);
-
-	// If the node has no children and it is not the end of a word, we remove it
-	if (node->children[key[index] - 'a']->n_children == 0 &&
-		node->children[key[index] - 'a']->end_of_word == 0) {
-		// We free the memory of the children vector
-		if (node->children[key[index] - 'a']->children) {
-			free(node->children[key[index] - 'a']->children);
-			node->children[key[index] - 'a']->children = NULL;
-		}
-
-		// We free the node
-		if (node->children[key[index] - 'a']) {
-			free(node->children[key[index] - 'a']);
-			node->children[key[index] - 'a'] = NULL;
+	u8 letters[TRIE_MAX_ALPHABET];
+	u32 children[TRIE_MAX_ALPHABET];
+	int n = trie_children(trie, node, letters, children);
+
+	for (int i = 0; i < n; i++) {
+		int *next = row + len + 1;
+		int min;
+
+		// A branch that REMOVE left without words has nothing to print,
+		// nor one whose words cannot beat the ones already found
+		if (trie->nodes[children[i]].nwords == 0 ||
+			!trie_fuzzy_promising(trie, fuzzy, children[i], level + 1))
+			continue;
+
+		fuzzy->path[level] = trie->alphabet[letters[i]];
+
+		// The row of the child: deletion, insertion or substitution
+		next[0] = level + 1;
+		min = next[0];
+		for (int j = 1; j <= len; j++) {
+			int cost = row[j - 1] + (fuzzy->letters[j - 1] != letters[i]);
+
+			if (row[j] + 1 < cost)
+				cost = row[j] + 1;
+			if (next[j - 1] + 1 < cost)
+				cost = next[j - 1] + 1;
+			next[j] = cost;
+			if (cost < min)
+				min = cost;
 		}
 
-		// We decrement the number of children of the current node
-		node->n_children--;
-
-		// We decrement the number of nodes in the trie
-		trie->nnodes--;
+		if (min <= fuzzy->k)
+			DFS_fuzzy(trie, fuzzy, children[i], level + 1);
 	}
 }
 
 /******************************************************************************
- * This function removes a word from the trie.
+ * This function performs autocomplete on a trie, for a prefix that may be
+ * mistyped: the words considered are the ones that start with a string
+ * within edit distance k of the prefix, and they are ranked like the ones of
+ * trie_autocomplete, which answers the queries with k = 0.
  *
  * @param trie - A pointer to the trie data structure.
- * @param key - The word that has to be removed from the trie.
+ * @param prefix - The prefix to match.
+ * @param task - The task, see trie_autocomplete.
+ * @param k - The maximum edit distance to the prefix.
  *****************************************************************************/
-void trie_remove(trie_t *trie, char *key)
+void trie_autocomplete_fuzzy(trie_t *trie, char *prefix, int task, int k)
 {
-	// Start from the root
-	trie_node_t *node = trie->root;
-
-	// Call the helper function
-	trie_remove_helper(trie, node, key, 0);
-}
+	trie_fuzzy_t fuzzy;
+	int len = strlen(prefix), levels;
 
-/******************************************************************************
- * This function is a helper function that is used to free the memory
- * allocated by trie.
- *
- * @param node - A pointer to the node that has to be freed.
- *****************************************************************************/
-void trie_helper_free(trie_node_t *node)
-{
-	// If the node is NULL, return
-	if (!node)
+	// Without typos it is the walk of the prefix
+	if (k == 0) {
+		trie_autocomplete(trie, prefix, task);
 		return;
+	}
+	if (task < 0 || task > 3)
+		return;
+	STATS_ADD(trie, fuzzy, 1);
+	STATS_START(trie, fuzzy_nodes, nodes);
+
+	// With k >= len the root is already on the frontier
+	fuzzy.len = len;
+	fuzzy.k = k < len ? k : len;
+	fuzzy.task = task;
+	for (int i = 0; i < 3; i++)
+		fuzzy.lens[i] = -1;
+
+	// A path on the frontier has at most len + k letters
+	levels = len + (fuzzy.k > 0 ? fuzzy.k : 0) + 2;
+	fuzzy.rows = malloc(levels * (len + 1) * sizeof(int));
+	DIE(!fuzzy.rows, "Failed to allocate memory for the Levenshtein rows");
+
+	fuzzy.path = malloc(levels);
+	DIE(!fuzzy.path, "Failed to allocate memory for the path");
+
+	fuzzy.letters = malloc(len + 1);
+	DIE(!fuzzy.letters, "Failed to allocate memory for the prefix");
+	trie_query_letters(trie, prefix, len, fuzzy.letters);
+
+	// The row of the root: the distance to every prefix of the prefix
+	for (int j = 0; j <= len; j++)
+		fuzzy.rows[j] = j;
+
+	if (k >= 0 && trie->nodes[trie->root].lex_dir != TRIE_NONE)
+		DFS_fuzzy(trie, &fuzzy, trie->root, 0);
+
+	for (int i = 0; i < 3; i++) {
+		if (task != 0 && task != i + 1)
+			continue;
+		if (fuzzy.lens[i] < 0)
+			io_write_line(trie->out, "No words found", 14);
+		else
+			io_write_line(trie->out, fuzzy.words[i], fuzzy.lens[i]);
+	}
 
-	// If the node has children, we free the memory allocated for the children
-	for (int i = 0; i < ALPHABET_SIZE; i++)
-		trie_helper_free(node->children[i]);
-
-	// Free the memory allocated for the children vector
-	free(node->children);
-	node->children = NULL;
+	STATS_STOP(trie, fuzzy_nodes, nodes);
+	STATS_ADD(trie, bytes, levels * (len + 1) * sizeof(int) + levels +
+			  len + 1);
 
-	// Free the node
-	free(node);
-	node = NULL;
+	free(fuzzy.rows);
+	free(fuzzy.path);
+	free(fuzzy.letters);
 }
 
+/* A prefix of a batch and its position in the batch */
+typedef struct trie_batch_entry_t trie_batch_entry_t;
+struct trie_batch_entry_t {
+	char *prefix;
+	int len;
+	int index;
+};
+
+/* The completion of every task of a query of a batch, in a pool */
+typedef struct trie_batch_answer_t trie_batch_answer_t;
+struct trie_batch_answer_t {
+	int offset[3];
+	int len[3];
+};
+
 /******************************************************************************
- * This function frees the memory allocated by a trie.
+ * This function sorts the prefixes of a batch in lexicographic order, with a
+ * three-way radix quicksort: the entries are split by their letter at a
+ * depth, and only the ones that share it are compared further, so the
+ * letters of the common prefixes are not compared again and again.
  *
- * @param ptrie - A double pointer to the trie data structure.
+ * @param entries - The entries of the batch.
+ * @param n - The number of entries.
+ * @param depth - The number of letters that all the entries share.
  *****************************************************************************/
-void trie_free(trie_t **ptrie)
+static void trie_batch_sort(trie_batch_entry_t *entries, int n, int depth)
 {
-	trie_helper_free((*ptrie)->root);
-	free(*ptrie);
-	*ptrie = NULL;
+	while (n > 1) {
+		int pivot = (unsigned char)entries[n / 2].prefix[depth];
+		int lt = 0, i = 0, gt = n;
+
+		// [0, lt) has a smaller letter, [lt, gt) the pivot, [gt, n) bigger
+		while (i < gt) {
+			int c = (unsigned char)entries[i].prefix[depth];
+			trie_batch_entry_t tmp = entries[i];
+
+			if (c < pivot) {
+				entries[i++] = entries[lt];
+				entries[lt++] = tmp;
+			} else if (c > pivot) {
+				entries[i] = entries[--gt];
+				entries[gt] = tmp;
+			} else {
+				i++;
+			}
+		}
+
+		trie_batch_sort(entries, lt, depth);
+		trie_batch_sort(entries + gt, n - gt, depth);
+
+		// The entries that end at this depth are equal
+		if (pivot == '\0')
+			return;
+		entries += lt;
+		n = gt - lt;
+		depth++;
+	}
 }
 
 /******************************************************************************
- * This function compares the command read from the keyboard with the commands
- * preset by mk.
+ * This function folds the prefixes of a batch the way the words are stored,
+ * one after the other in a pool. A prefix with a character outside of the
+ * alphabet, or too long to be in the trie, is kept as it is.
  *
- * @param command - The command read from the keyboard.
+ * @param trie - A pointer to the trie data structure.
+ * @param prefixes - The prefixes of the queries.
+ * @param entries - The entries of the batch, filled in the order of the
+ *                  queries.
+ * @param n - The number of queries.
+ * @param size - A pointer to where the size of the pool is written.
+ *
+ * @return pool - The pool, to be freed by the caller.
  *****************************************************************************/
-int which_command(char *command)
+static char *trie_batch_fold(trie_t *trie, char **prefixes,
+							 trie_batch_entry_t *entries, int n, size_t *size)
 {
-	// We compare the command with the preset commands
-	if (strcmp(command, "LOAD") == 0)
-		return LOAD;
-	if (strcmp(command, "INSERT") == 0)
-		return INSERT;
-	if (strcmp(command, "REMOVE") == 0)
-		return REMOVE;
-	if (strcmp(command, "EXIT") == 0)
-		return -1;
-	if (strcmp(command, "AUTOCORRECT") == 0)
-		return AUTOCORRECT;
-	if (strcmp(command, "AUTOCOMPLETE") == 0)
-		return AUTOCOMPLETE;
+	*size = 0;
+	for (int i = 0; i < n; i++)
+		*size += strlen(prefixes[i]) + 1;
+	char *pool = malloc(*size), *word = pool;
+	DIE(!pool, "Failed to allocate the prefixes of the batch");
+
+	for (int i = 0; i < n; i++) {
+		entries[i].prefix = word;
+		entries[i].len = trie_fold_word(trie, prefixes[i], word);
+		entries[i].index = i;
+		if (entries[i].len < 0) {
+			entries[i].prefix = prefixes[i];
+			entries[i].len = strlen(prefixes[i]);
+		}
+		word += entries[i].len + 1;
+	}
 
-	// If the command is not preset, we return -1
-	return -1;
+	return pool;
 }
 
 /******************************************************************************
- * This function inserts in a trie all the words that are in the file given as
- * a parameter.
+ * This function finds the node of a prefix of a sorted batch. The letters it
+ * shares with the previous prefix were already walked, so only the rest of
+ * them are.
  *
  * @param trie - A pointer to the trie data structure.
- * @param filename - The name of the file that contains the words.
+ * @param path - path[d] is the node of the first d letters of the previous
+ *               prefix, for the letters that were walked. It is updated for
+ *               the prefix.
+ * @param prefix - The prefix.
+ * @param prev - The previous prefix, "" for the first one.
+ * @param walked - A pointer to the number of letters of the previous prefix
+ *                 that were walked, updated for the prefix.
+ *
+ * @return node - The node of the prefix, TRIE_NIL if no word starts with it.
  *****************************************************************************/
-void trie_load(trie_t *trie, char *filename)
+static u32 trie_batch_walk(trie_t *trie, u32 *path, char *prefix,
+						   char *prev, int *walked)
 {
-	// Open the file
-	FILE *file = fopen(filename, "r");
-	DIE(!file, "Failed to open file");
+	int depth = 0;
 
-	// Allocate memory for the word
-	char *word = malloc(MAX_STRING_SIZE * sizeof(char));
-	DIE(!word, "Failed to allocate memory for word");
+	while (depth < *walked && prefix[depth] &&
+		   prefix[depth] == prev[depth])
+		depth++;
 
-	// Read the words from the file and insert them in the trie
-	while (!feof(file)) {
-		// Read the word
-		fscanf(file, "%s", word);
+	// Walk the letters that the previous prefix does not share
+	u32 node = path[depth];
 
-		// Insert the word in the trie
-		trie_insert(trie, word);
-	}
+	while (prefix[depth] && node != TRIE_NIL) {
+		int letter = trie->fold[(unsigned char)prefix[depth]] - 1;
 
-	// Close the file
-	fclose(file);
+		node = letter < 0 ? TRIE_NIL : trie_child(trie, node, letter);
+		if (node != TRIE_NIL)
+			path[++depth] = node;
+	}
+	*walked = depth;
 
-	// Free the memory allocated for the word
-	free(word);
+	return node;
 }
 
 /******************************************************************************
- * This function performs depth-first search (DFS) for autocorrect in a trie.
+ * This function prints the results of a batch, in the order of the batch.
  *
- * @param node: Pointer to the trie node
- * @param word: The word to autocorrect
- * @param k: The maximum number of allowed differences between words
- * @param trie_word: The current word formed in the trie traversal
- * @param level: The current level of the trie traversal
- * @param ok: Pointer to a flag indicating if an autocorrected word was found
+ * @param trie - A pointer to the trie data structure.
+ * @param answers - The completions of every query.
+ * @param tasks - The task of every query.
+ * @param found - The completions the answers point at.
+ * @param n - The number of queries.
  *****************************************************************************/
-void DFS_autocorrect(trie_node_t *node, char *word, int k, char *trie_word,
-					 int level, int *ok)
+static void trie_batch_print(trie_t *trie, trie_batch_answer_t *answers,
+							 int *tasks, char *found, int n)
 {
-	// If the node is NULL, return
-	if (!node)
-		return;
-
-	// If the node is the end of a word, we verify if the word is valid
-	if (node->end_of_word != 0 && level == (int)strlen(word)) {
-		trie_word[strlen(word)] = '\0';
-		int count = 0;
-		// We compare the word with the trie_word
-		for (int j = 0; j < (int)strlen(word); j++) {
-			if (word[j] != trie_word[j])
-				count++;
-		}
-		if (count <= k) {
-			*ok = 1;
-			printf("%s\n", trie_word);
-			return;
-		}
-	}
-	if (level > (int)strlen(word))
-		return;
-
-	// If the node has children, we continue the DFS
-	if (node->n_children != 0) {
-		for (int i = 0; i < ALPHABET_SIZE; i++) {
-			// If the current letter is in the trie, we continue the DFS
-			if (node->children[i]) {
-				// We add the current letter to the trie_word
-				trie_word[level] = i + 'a';
-
-				// We continue the DFS
-				DFS_autocorrect(node->children[i], word, k, trie_word,
-								level + 1, ok);
-			}
+	for (int i = 0; i < n; i++) {
+		for (int task = 1; task <= 3 && tasks[i] >= 0 && tasks[i] <= 3;
+			 task++) {
+			int offset = answers[i].offset[task - 1];
+
+			if (tasks[i] != 0 && task != tasks[i])
+				continue;
+			if (offset < 0)
+				io_write_line(trie->out, "No words found", 14);
+			else
+				io_write_line(trie->out, found + offset,
+							  answers[i].len[task - 1]);
 		}
 	}
 }
 
 /******************************************************************************
- * This function performs autocorrect on a trie.
+ * This function performs many AUTOCOMPLETE queries at once. The prefixes are
+ * sorted, so that related prefixes ("th", "the", "ther") follow each other,
+ * and answered in a single pass:
+ *  - every prefix starts its walk from the node of the prefix it shares
+ *    with the previous one, kept on the path of the previous walk;
+ *  - the completion of a longer prefix is the one of a shorter prefix of it
+ *    whenever that word starts with the longer prefix (it is the best word
+ *    of a bigger set), so only the other ones follow the summaries.
+ * Every completion is kept once in a pool, and the queries only point at
+ * it, so the results are printed in the order of the batch.
  *
- * @param trie: Pointer to the trie structure
- * @param word: The input word to autocorrect
- * @param k: The maximum number of allowed differences between words
+ * @param trie - A pointer to the trie data structure.
+ * @param prefixes - The prefixes of the queries.
+ * @param tasks - The task of every query, see trie_autocomplete.
+ * @param n - The number of queries.
  *****************************************************************************/
-void trie_autocorrect(trie_t *trie, char *word, int k)
+void trie_autocomplete_batch(trie_t *trie, char **prefixes, int *tasks, int n)
 {
-	// Start from the root
-	trie_node_t *node = trie->root;
-	int ok = 0;
+	u32 path[MAX_STRING_SIZE];
+	char *prev = "";
+	int walked = 0;
 
-	// Allocate memory for the trie_word
-	char *trie_word = malloc(MAX_STRING_SIZE * sizeof(char));
-	DIE(!trie_word, "Failed to allocate memory for trie_word");
+	// The last completion of every task and the prefix it was found for
+	int best[4] = {-1, -1, -1, -1}, best_len[4] = {0}, best_prefix[4] = {0};
 
-	// We call the DFS function
-	DFS_autocorrect(node, word, k, trie_word, 0, &ok);
+	if (n <= 0)
+		return;
+	STATS_ADD(trie, batch, n);
+	STATS_START(trie, batch_nodes, nodes);
+
+	// The prefixes as they are stored, one after the other in a pool
+	trie_batch_entry_t *entries = malloc(n * sizeof(trie_batch_entry_t));
+	DIE(!entries, "Failed to allocate the batch");
+	size_t size;
+	char *pool = trie_batch_fold(trie, prefixes, entries, n, &size);
+
+	trie_batch_sort(entries, n, 0);
+
+	// The completions found, and the one of every task of every query
+	io_buffer_t found = {.fd = -1, .len = 0, .cap = 4 * MAX_STRING_SIZE};
+	trie_batch_answer_t *answers = malloc(n * sizeof(trie_batch_answer_t));
+	DIE(!answers, "Failed to allocate the results of the batch");
+	found.data = malloc(found.cap);
+	DIE(!found.data, "Failed to allocate the completions of the batch");
+
+	// path[d] is the node of the first d letters of the previous prefix,
+	// for the letters that were walked
+	path[0] = trie->root;
+	for (int i = 0; i < n; i++) {
+		char *prefix = entries[i].prefix;
+		int len = entries[i].len, k = tasks[entries[i].index];
+		u32 node = trie_batch_walk(trie, path, prefix, prev, &walked);
+
+		prev = prefix;
+
+		// Task 0 gives the results of the three tasks
+		for (int task = 1; task <= 3 && k >= 0 && k <= 3; task++) {
+			if (k != 0 && task != k)
+				continue;
+
+			if (best[task] < 0 || best_prefix[task] > len ||
+				best_len[task] < len ||
+				memcmp(found.data + best[task], prefix, len) != 0) {
+				if (found.len + MAX_STRING_SIZE > found.cap) {
+					found.cap *= 2;
+					found.data = realloc(found.data, found.cap);
+					DIE(!found.data, "Failed to grow the completions");
+				}
+				best_len[task] = trie_completion(trie, node, prefix, task,
+												 found.data + found.len);
+				best[task] = best_len[task] < 0 ? -1 : (int)found.len;
+				if (best[task] >= 0)
+					found.len += best_len[task];
+				best_prefix[task] = len;
+			}
+			answers[entries[i].index].offset[task - 1] = best[task];
+			answers[entries[i].index].len[task - 1] = best_len[task];
+		}
+	}
 
-	// If the word is not valid, we print "No words found"
-	if (ok == 0)
-		printf("No words found\n");
+	trie_batch_print(trie, answers, tasks, found.data, n);
 
-	// Free the memory allocated for the trie_word
-	free(trie_word);
+	STATS_STOP(trie, batch_nodes, nodes);
+	STATS_ADD(trie, bytes, n * (sizeof(trie_batch_entry_t) +
+								sizeof(trie_batch_answer_t)) +
+			  size + found.cap);
+
+	free(found.data);
+	free(answers);
+	free(entries);
+	free(pool);
 }
 
 /******************************************************************************
- * This function prints the result of task_1 in the autocomplete process.
+ * This function compares two entries of the best-first search: the higher
+ * frequency comes first, and equal frequencies go in lexicographic order.
+ * The letters of a subtree entry are its prefix, which orders it like its
+ * best word against every entry outside the subtree.
  *
- * @param ok_1 - Flag indicating if a word was found (1) or not (0).
- * @param lex_word - The lexicographically smallest word found.
-*****************************************************************************/
-void print_task_1(int ok_1, char *lex_word)
+ * @param pool - The pool with the letters of the entries.
+ * @param a - The first entry.
+ * @param b - The second entry.
+ *
+ * @return result - 1 if a comes before b, 0 otherwise.
+ *****************************************************************************/
+static int top_before(char *pool, top_entry_t *a, top_entry_t *b)
 {
-	if (ok_1 == 0)
-		printf("No words found\n");
-	else
-		printf("%s\n", lex_word);
+	int len = a->len < b->len ? a->len : b->len;
+	int cmp;
+
+	if (a->freq != b->freq)
+		return a->freq > b->freq;
+
+	cmp = memcmp(pool + a->offset, pool + b->offset, len);
+	if (cmp != 0)
+		return cmp < 0;
+	return a->len < b->len;
 }
 
 /******************************************************************************
- * This function prints the result of task_2 in the autocomplete process.
+ * This function adds an entry to the heap of the best-first search.
  *
- * @param ok_2 - Flag indicating if a word was found (1) or not (0).
- * @param shortest_word - The shortest word found.
-*****************************************************************************/
-void print_task_2(int ok_2, char *shortest_word)
+ * @param heap - A pointer to the heap vector, grown when it is full.
+ * @param size - A pointer to the number of entries in the heap.
+ * @param cap - A pointer to the capacity of the heap.
+ * @param pool - The pool with the letters of the entries.
+ * @param entry - The entry that is added.
+ *****************************************************************************/
+static void top_push(top_entry_t **heap, int *size, int *cap, char *pool,
+					 top_entry_t entry)
 {
-	if (ok_2 == 0)
-		printf("No words found\n");
-	else
-		printf("%s\n", shortest_word);
+	int i = (*size)++;
+
+	if (*size > *cap) {
+		*cap *= 2;
+		*heap = realloc(*heap, *cap * sizeof(top_entry_t));
+		DIE(!*heap, "Failed to grow the autocomplete heap");
+	}
+
+	// Sift the entry up while it comes before its parent
+	while (i > 0 && top_before(pool, &entry, &(*heap)[(i - 1) / 2])) {
+		(*heap)[i] = (*heap)[(i - 1) / 2];
+		i = (i - 1) / 2;
+	}
+	(*heap)[i] = entry;
 }
 
 /******************************************************************************
- * This function prints the result of task_3 in the autocomplete process.
+ * This function removes the best entry from the heap of the best-first search.
  *
- * @param ok_3 - Flag indicating if a word was found (1) or not (0).
- * @param freq_word - The word with the highest frequency found.
-*****************************************************************************/
-void print_task_3(int ok_3, char *freq_word)
+ * @param heap - The heap vector.
+ * @param size - A pointer to the number of entries in the heap.
+ * @param pool - The pool with the letters of the entries.
+ *
+ * @return entry - The entry that comes first.
+ *****************************************************************************/
+static top_entry_t top_pop(top_entry_t *heap, int *size, char *pool)
 {
-	if (ok_3 == 0)
-		printf("No words found\n");
-	else
-		printf("%s\n", freq_word);
+	top_entry_t best = heap[0];
+	top_entry_t last = heap[--(*size)];
+	int i = 0;
+
+	// Sift the last entry down from the top
+	while (2 * i + 1 < *size) {
+		int child = 2 * i + 1;
+
+		if (child + 1 < *size && top_before(pool, &heap[child + 1],
+											&heap[child]))
+			child++;
+		if (!top_before(pool, &heap[child], &last))
+			break;
+		heap[i] = heap[child];
+		i = child;
+	}
+	heap[i] = last;
+
+	return best;
 }
 
 /******************************************************************************
- * This function performs a depth-first search on a trie data structure,
- * starting from a given node and a specified prefix. It searches for the
- * lexicographically smallest word that matches the prefix and updates the
- * lex_word parameter accordingly.
+ * This function copies the letters of an entry, followed by one more letter,
+ * at the end of the character pool.
  *
- * @param node - A pointer to the current node in the trie.
- * @param prefix - The prefix to match.
- * @param lex_word - The lexicographically smallest word found so far.
- * @param aux - An auxiliary buffer to store the current word being constructed
- * @param level - The current level in the trie.
- * @param ok_1 - A pointer to a flag indicating if a valid word has been found.
-*****************************************************************************/
-void task_1(trie_node_t *node, char *prefix, char *lex_word, char *aux,
-			int level, int *ok_1)
+ * @param pool - A pointer to the pool, grown when it is full.
+ * @param used - A pointer to the number of characters used in the pool.
+ * @param cap - A pointer to the capacity of the pool.
+ * @param entry - The entry whose letters are copied.
+ * @param letter - The letter that is appended.
+ *
+ * @return offset - The position of the new letters in the pool.
+ *****************************************************************************/
+static int top_extend(char **pool, int *used, int *cap, top_entry_t *entry,
+					  char letter)
 {
-	// If the node is NULL, return
-	if (!node)
-		return;
+	int offset = *used;
 
-	// If the level is 0, we iterate through the prefix
-	if (level == 0) {
-		for (int i = 0; i < (int)strlen(prefix); i++) {
-			if (node->children[prefix[i] - 'a'] != NULL) {
-				aux[level] = prefix[i];
-				node = node->children[prefix[i] - 'a'];
-				level++;
-			} else {
-				return;
-			}
-		}
+	while (*used + entry->len + 1 > *cap) {
+		*cap *= 2;
+		*pool = realloc(*pool, *cap);
+		DIE(!*pool, "Failed to grow the autocomplete pool");
 	}
 
-	// If the node is the end of a word, we verify if the word is valid
-	if (node->end_of_word != 0) {
-		aux[level] = '\0';
-		if (strcmp(aux, lex_word) < 0) {
-			*ok_1 = 1;
-			strcpy(lex_word, aux);
-			return;
-		}
-	}
+	memcpy(*pool + offset, *pool + entry->offset, entry->len);
+	(*pool)[offset + entry->len] = letter;
+	*used += entry->len + 1;
 
-	// If the node has children, we continue the DFS
-	if (node->n_children != 0) {
-		for (int i = 0; i < ALPHABET_SIZE; i++) {
-			// If the current letter is in the trie, we continue the DFS
-			if (node->children[i]) {
-				// We add the current letter to the trie_word
-				aux[level] = i + 'a';
-
-				// We continue the DFS
-			   task_1(node->children[i], prefix, lex_word, aux, level + 1,
-					  ok_1);
-			}
-		}
-	}
+	return offset;
 }
 
 /******************************************************************************
- * This function finds the shortest word in a trie that matches a given prefix.
+ * This function finds the words of an AUTOCOMPLETE TOP, see
+ * trie_autocomplete_top.
  *
- * @param node - A pointer to the current node in the trie.
+ * The search is best-first: the heap holds whole subtrees ranked by their
+ * most frequent word (known from the summaries) and single words. Only the
+ * subtrees that reach the top of the heap are opened, so the work depends on
+ * n and on the length of the words, not on the size of the subtree.
+ *
+ * @param trie - A pointer to the trie data structure.
  * @param prefix - The prefix to match.
- * @param shortest_word - The shortest word found so far.
- * @param aux - An auxiliary buffer to store the current word being constructed
- * @param level - The current level in the trie.
- * @param ok_2 - A pointer to a flag indicating if a valid word has been found.
-*****************************************************************************/
-void task_2(trie_node_t *node, char *prefix, char *shortest_word, char *aux,
-			int level, int *ok_2)
+ * @param n - The number of words to print.
+ *****************************************************************************/
+static void trie_top_words(trie_t *trie, char *prefix, int n)
 {
-	// If the node is NULL, return
-	if (!node)
+	char word[MAX_STRING_SIZE];
+
+	// The words start with the prefix as it is stored
+	if (trie_fold_word(trie, prefix, word) >= 0)
+		prefix = word;
+
+	u32 node = trie_find_prefix(trie, prefix);
+	int size = 0, heap_cap = 64, pool_used, pool_cap = MAX_STRING_SIZE;
+	int found = 0;
+
+	// The frequencies of a frozen trie are not in its nodes
+	if (trie->frozen) {
+		dawg_autocomplete_top(trie, prefix, n);
 		return;
+	}
 
-	// If the level is greater than the length of the shortest word, we return
-	if (level > (int)strlen(shortest_word))
+	if (node == TRIE_NIL || trie->nodes[node].freq_dir == TRIE_NONE) {
+		io_write_line(trie->out, "No words found", 14);
 		return;
+	}
 
-	// If the level is 0, we iterate through the prefix
-	if (level == 0) {
-		for (int i = 0; i < (int)strlen(prefix); i++) {
-			if (node->children[prefix[i] - 'a']) {
-				aux[level] = prefix[i];
-				node = node->children[prefix[i] - 'a'];
-				level++;
-			} else {
-				return;
-			}
+	top_entry_t *heap = malloc(heap_cap * sizeof(top_entry_t));
+	DIE(!heap, "Failed to allocate memory for the autocomplete heap");
+
+	char *pool = malloc(pool_cap);
+	DIE(!pool, "Failed to allocate memory for the autocomplete pool");
+
+	// The search starts from the whole subtree of the prefix
+	pool_used = strlen(prefix);
+	memcpy(pool, prefix, pool_used);
+	STATS_ADD(trie, top_entries, 1);
+	top_push(&heap, &size, &heap_cap, pool, (top_entry_t){node,
+			 trie->nodes[node].best_freq, 0, 0, pool_used});
+
+	while (size > 0 && found < n) {
+		top_entry_t entry = top_pop(heap, &size, pool);
+
+		// A word that reaches the top of the heap is the next answer
+		if (entry.is_word) {
+			io_write_line(trie->out, pool + entry.offset, entry.len);
+			found++;
+			continue;
 		}
-	}
 
-	// If the node is the end of a word, we verify if the word is valid
-	if (node->end_of_word != 0) {
-		aux[level] = '\0';
-		if (strlen(aux) < strlen(shortest_word)) {
-			*ok_2 = 1;
-			strcpy(shortest_word, aux);
+		// Otherwise we open the subtree: its own word and its children
+		trie_node_t *current = &trie->nodes[entry.node];
+		u8 letters[TRIE_MAX_ALPHABET];
+		u32 children[TRIE_MAX_ALPHABET];
+		int nc = trie_children(trie, entry.node, letters, children);
+
+		if (current->end_of_word != 0) {
+			entry.is_word = 1;
+			entry.freq = current->end_of_word;
+			STATS_ADD(trie, top_entries, 1);
+			top_push(&heap, &size, &heap_cap, pool, entry);
 		}
-	}
 
-	// If the node has children, we continue the DFS
-	if (node->n_children != 0) {
-		for (int i = 0; i < ALPHABET_SIZE; i++) {
-			// If the current letter is in the trie, we continue the DFS
-			if (node->children[i]) {
-				// We add the current letter to the trie_word
-				aux[level] = i + 'a';
-
-				// We continue the DFS
-				task_2(node->children[i], prefix, shortest_word, aux,
-					   level + 1, ok_2);
-			}
+		for (int i = 0; i < nc; i++) {
+			if (trie->nodes[children[i]].freq_dir == TRIE_NONE)
+				continue;
+
+			top_entry_t child = {children[i],
+				trie->nodes[children[i]].best_freq, 0,
+				top_extend(&pool, &pool_used, &pool_cap, &entry,
+						   trie->alphabet[letters[i]]), entry.len + 1};
+			STATS_ADD(trie, top_entries, 1);
+			top_push(&heap, &size, &heap_cap, pool, child);
 		}
 	}
+
+	STATS_ADD(trie, bytes, heap_cap * sizeof(top_entry_t) + pool_cap);
+
+	free(heap);
+	free(pool);
 }
 
 /******************************************************************************
- * This function finds the word with the highest frequency in a trie that
- * matches a given prefix.
+ * This function prints the n most frequent words that start with a prefix,
+ * the most frequent first and equal frequencies in lexicographic order.
  *
- * @param node - A pointer to the current node in the trie.
+ * @param trie - A pointer to the trie data structure.
  * @param prefix - The prefix to match.
- * @param freq_word - The word with the highest frequency found so far.
- * @param aux - An auxiliary buffer to store the current word being constructed
- * @param level - The current level in the trie.
- * @param ok_3 - A pointer to a flag indicating if a valid word has been found.
- * @param max_freq - A pointer to the maximum frequency found so far.
-*****************************************************************************/
-void task_3(trie_node_t *node, char *prefix, char *freq_word, char *aux,
-			int level, int *ok_3, int *max_freq)
+ * @param n - The number of words to print.
+ *****************************************************************************/
+void trie_autocomplete_top(trie_t *trie, char *prefix, int n)
 {
-	// If the node is NULL, return
-	if (!node)
+	// A repeated query is answered by the cache
+	if (cache_begin(trie, CACHE_TOP, prefix, n))
 		return;
 
-	// If the level is 0, we iterate through the prefix
-	if (level == 0) {
-		for (int i = 0; i < (int)strlen(prefix); i++) {
-			if (node->children[prefix[i] - 'a']) {
-				aux[level] = prefix[i];
-				node = node->children[prefix[i] - 'a'];
-				level++;
-			} else {
-				return;
-			}
-		}
-	}
-
-	// If the node is the end of a word, we verify if the word is valid
-	if (node->end_of_word != 0) {
-		aux[level] = '\0';
-		if (node->end_of_word > *max_freq) {
-			*ok_3 = 1;
-			strcpy(freq_word, aux);
-			*max_freq = node->end_of_word;
-		}
-	}
-
-	// If the node has children, we continue the DFS
-	if (node->n_children != 0) {
-		for (int i = 0; i < ALPHABET_SIZE; i++) {
-			// If the current letter is in the trie, we continue the DFS
-			if (node->children[i]) {
-				// We add the current letter to the trie_word
-				aux[level] = i + 'a';
-
-				// We continue the DFS
-				task_3(node->children[i], prefix, freq_word, aux, level + 1,
-					   ok_3, max_freq);
-			}
-		}
-	}
+	STATS_ADD(trie, top, 1);
+	STATS_START(trie, top_nodes, nodes);
+	trie_top_words(trie, prefix, n);
+	STATS_STOP(trie, top_nodes, nodes);
+	cache_end(trie);
 }
 
 /******************************************************************************
- * This function performs autocomplete on a trie given a prefix and returns
- * results based on the specified criteria.
+ * This function places a cursor before the first word that starts with a
+ * prefix.
  *
+ * @param cursor - A pointer to the cursor.
  * @param trie - A pointer to the trie data structure.
  * @param prefix - The prefix to match.
- * @param k - The criteria for autocomplete results:
- *      - k = 0: Returns the lexicographically smallest word, the shortest word,
- *               and the word with the highest frequency.
- *      - k = 1: Returns the lexicographically smallest word.
- *      - k = 2: Returns the shortest word.
- *      - k = 3: Returns the word with the highest frequency.
-*****************************************************************************/
-void trie_autocomplete(trie_t *trie, char *prefix, int k)
+ *****************************************************************************/
+void trie_cursor_init(trie_cursor_t *cursor, trie_t *trie, char *prefix)
 {
-	// We allocate memory for the words
-	int ok_1 = 0;
-	int ok_2 = 0;
-	int ok_3 = 0;
+	char word[MAX_STRING_SIZE];
+
+	// The words start with the prefix as it is stored
+	if (trie_fold_word(trie, prefix, word) >= 0)
+		prefix = word;
 
-	int max_freq = 0;
+	u32 node = trie_find_prefix(trie, prefix);
 
-	// Allocate memory for the words
-	char *lex_word = malloc(MAX_STRING_SIZE * sizeof(char));
-	DIE(!lex_word, "Failed to allocate memory for lexicographic_word");
-	strcpy(lex_word, "zzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzz");
+	cursor->trie = trie;
+	cursor->depth = -1;
+	cursor->len = strlen(prefix);
+	if (node == TRIE_NIL || trie->nodes[node].nwords == 0 ||
+		cursor->len >= MAX_STRING_SIZE)
+		return;
 
-	char *freq_word = malloc(MAX_STRING_SIZE * sizeof(char));
-	DIE(!freq_word, "Failed to allocate memory for frequency_word");
-	strcpy(freq_word, "zzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzz");
+	memcpy(cursor->word, prefix, cursor->len);
+	cursor->path[0] = node;
+	cursor->next[0] = -1;
+	cursor->depth = 0;
+}
 
-	char *shortest_word = malloc(MAX_STRING_SIZE * sizeof(char));
-	DIE(!shortest_word, "Failed to allocate memory for shortest_word");
-	strcpy(shortest_word, "zzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzz");
+/******************************************************************************
+ * This function moves a cursor up, out of the last node of its path.
+ *
+ * @param cursor - A pointer to the cursor.
+ *****************************************************************************/
+static void trie_cursor_pop(trie_cursor_t *cursor)
+{
+	if (cursor->depth-- > 0)
+		cursor->len--;
+}
 
-	char *aux = malloc(MAX_STRING_SIZE * sizeof(char));
-	DIE(!aux, "Failed to allocate memory for aux");
-	strcpy(aux, "");
+/******************************************************************************
+ * This function moves a cursor down, into a child of the last node of its
+ * path.
+ *
+ * @param cursor - A pointer to the cursor.
+ * @param letter - The letter of the child.
+ * @param child - The index of the child.
+ *****************************************************************************/
+static void trie_cursor_push(trie_cursor_t *cursor, int letter,
+							 u32 child)
+{
+	cursor->next[cursor->depth] = letter + 1;
+	cursor->word[cursor->len++] = cursor->trie->alphabet[letter];
+	cursor->depth++;
+	cursor->path[cursor->depth] = child;
+	cursor->next[cursor->depth] = -1;
+}
 
-	// We call the task functions
-	switch (k) {
-	// If k = 0, we call all the task functions
-	case 0:
-		task_1(trie->root, prefix, lex_word, aux, 0, &ok_1);
+/******************************************************************************
+ * This function moves a cursor past the next n words. The subtrees whose
+ * words are all skipped are counted by their number of words and not
+ * entered, so the cost depends on the length of the words, not on n.
+ *
+ * @param cursor - A pointer to the cursor.
+ * @param n - The number of words to skip.
+ *****************************************************************************/
+void trie_cursor_skip(trie_cursor_t *cursor, u32 n)
+{
+	trie_t *trie = cursor->trie;
 
-		print_task_1(ok_1, lex_word);
+	while (n > 0 && cursor->depth >= 0) {
+		u32 node = cursor->path[cursor->depth], child;
 
-		// We reset the auxiliary buffer
-		strcpy(aux, "");
+		// The word of a node comes before the words of its children
+		if (cursor->next[cursor->depth] < 0) {
+			cursor->next[cursor->depth] = 0;
+			if (trie->nodes[node].end_of_word != 0)
+				n--;
+			continue;
+		}
 
-		task_2(trie->root, prefix, shortest_word, aux, 0, &ok_2);
+		int letter = trie_next_child(trie, node, cursor->next[cursor->depth],
+									 &child);
 
-		print_task_2(ok_2, shortest_word);
+		if (letter < 0) {
+			trie_cursor_pop(cursor);
+		} else if (trie->nodes[child].nwords <= n) {
+			n -= trie->nodes[child].nwords;
+			cursor->next[cursor->depth] = letter + 1;
+		} else {
+			trie_cursor_push(cursor, letter, child);
+		}
+	}
+}
 
-		// We reset the auxiliary buffer
-		strcpy(aux, "");
+/******************************************************************************
+ * This function moves a cursor to the next word. The subtrees without words
+ * are not entered, so the cost of a word is the length of the path from the
+ * previous one.
+ *
+ * @param cursor - A pointer to the cursor.
+ *
+ * @return len - The length of the word, which is in cursor->word, -1 if
+ *               there are no more words.
+ *****************************************************************************/
+int trie_cursor_next(trie_cursor_t *cursor)
+{
+	trie_t *trie = cursor->trie;
 
-		task_3(trie->root, prefix, freq_word, aux, 0, &ok_3, &max_freq);
+	while (cursor->depth >= 0) {
+		u32 node = cursor->path[cursor->depth], child;
 
-		print_task_3(ok_3, freq_word);
+		if (cursor->next[cursor->depth] < 0) {
+			cursor->next[cursor->depth] = 0;
+			if (trie->nodes[node].end_of_word != 0)
+				return cursor->len;
+			continue;
+		}
 
-		// We reset the auxiliary buffer
-		strcpy(aux, "");
-		break;
+		int letter = trie_next_child(trie, node, cursor->next[cursor->depth],
+									 &child);
 
-	// If k = 1, we call the task_1 function
-	case 1:
-		task_1(trie->root, prefix, lex_word, aux, 0, &ok_1);
-		print_task_1(ok_1, lex_word);
-		break;
+		if (letter < 0)
+			trie_cursor_pop(cursor);
+		else if (trie->nodes[child].nwords == 0)
+			cursor->next[cursor->depth] = letter + 1;
+		else
+			trie_cursor_push(cursor, letter, child);
+	}
 
-	// If k = 2, we call the task_2 function
-	case 2:
-		task_2(trie->root, prefix, shortest_word, aux, 0, &ok_2);
-		print_task_2(ok_2, shortest_word);
-		break;
+	return -1;
+}
 
-	// If k = 3, we call the task_3 function
-	case 3:
-		task_3(trie->root, prefix, freq_word, aux, 0, &ok_3, &max_freq);
-		print_task_3(ok_3, freq_word);
-		break;
+/******************************************************************************
+ * This function prints a page of the words that start with a prefix, in
+ * lexicographic order: the words from the offset-th (from 0) on, at most
+ * limit of them. The cost depends on the words printed, not on the size of
+ * the subtree.
+ *
+ * @param trie - A pointer to the trie data structure.
+ * @param prefix - The prefix to match.
+ * @param offset - The number of words before the page.
+ * @param limit - The most words of the page.
+ *****************************************************************************/
+void trie_autocomplete_page(trie_t *trie, char *prefix, int offset,
+							int limit)
+{
+	trie_cursor_t cursor;
+	int len, printed = 0;
 
-	default:
-		// If the command is not preset, we return
-		break;
+	trie_cursor_init(&cursor, trie, prefix);
+	if (offset > 0)
+		trie_cursor_skip(&cursor, offset);
+
+	while (printed < limit && (len = trie_cursor_next(&cursor)) >= 0) {
+		io_write_line(trie->out, cursor.word, len);
+		printed++;
 	}
 
-	// Free the memory allocated for the words
-	free(lex_word);
-	free(freq_word);
-	free(shortest_word);
-	free(aux);
+	// Like the other queries, an empty answer says so
+	if (printed == 0)
+		io_write_line(trie->out, "No words found", 14);
 }
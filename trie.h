@@ -7,6 +7,12 @@
 #include <string.h>
 #include <stdlib.h>
 #include <errno.h>
+#include "types.h"
+#include "symspell.h"
+#include "wordstore.h"
+#include "wordcount.h"
+#include "io.h"
+#include "stats.h"
 
 #define MAX_STRING_SIZE 512
 
@@ -22,6 +28,29 @@
 
 #define AUTOCOMPLETE 32123
 
+#define MEMORY 6336
+
+#define SET 707
+
+#define LOADFREQ 54345
+
+#define FREEZE 8228
+
+#define SAVE 4554
+
+#define OPEN 1661
+
+#define BATCH 5225
+
+#define CACHE 2442
+
+#define STATS 7337
+
+#define COMPACT 9119
+
+/* Number of slots of the perfect hash table of the commands */
+#define TRIE_COMMAND_SLOTS 64
+
 #define DIE(assertion, call_description)				\
 	do {								\
 		if (assertion) {					\
@@ -32,47 +61,282 @@
 		}							\
 	} while (0)
 
+/* Default alphabet of the trie, SET alphabet changes it while it is empty */
 #define ALPHABET_SIZE 26
 #define ALPHABET "abcdefghijklmnopqrstuvwxyz"
 
+/* Largest number of symbols of an alphabet */
+#define TRIE_MAX_ALPHABET 64
+
+/* Index of the sentinel node, used as the "no child" value */
+#define TRIE_NIL 0
+
+/* Number of nodes reserved by the arena when the trie is created */
+#define TRIE_INITIAL_NODES 1024
+
+/* Number of 32-bit slots reserved by the child pool at creation */
+#define TRIE_INITIAL_KIDS 4096
+
+/*
+ * REMOVE leaves the nodes of the word in place: the trie is compacted once
+ * TRIE_COMPACT_PERCENT of its nodes hold no word, if they are at least
+ * TRIE_COMPACT_MIN_NODES (SET compact <percent> changes it, 0 disables it)
+ */
+#define TRIE_COMPACT_PERCENT 25
+#define TRIE_COMPACT_MIN_NODES 4096
+
+/*
+ * Node kinds, chosen by the number of children (Adaptive Radix Tree style):
+ *  - EMPTY:  no children block at all (most of the leaves)
+ *  - TINY:   up to TRIE_TINY_CAP children, keys kept sorted
+ *  - MEDIUM: up to TRIE_MEDIUM_CAP children, keys kept sorted
+ *  - FULL:   alphabet_size children, indexed directly by the letter
+ */
+#define TRIE_NODE_EMPTY 0
+#define TRIE_NODE_TINY 1
+#define TRIE_NODE_MEDIUM 2
+#define TRIE_NODE_FULL 3
+#define TRIE_NODE_KINDS 4
+
+#define TRIE_TINY_CAP 4
+#define TRIE_MEDIUM_CAP 12
+
+/*
+ * Values of the summary directions besides a letter: the best word of the
+ * subtree ends in the node itself, or the subtree holds no word at all.
+ */
+#define TRIE_SELF 0xFF
+#define TRIE_NONE 0xFE
+
+/* Length of the shortest word of an empty subtree */
+#define TRIE_NO_LENGTH 0xFFFF
+
+/* Number of word lengths told apart by the length mask of a node */
+#define TRIE_MASK_LENGTHS 32
+
 typedef struct trie_node_t trie_node_t;
 struct trie_node_t {
 	int end_of_word;
 
-	trie_node_t **children;
-	int n_children;
+	/* Frequency of the most frequent word of the subtree */
+	int best_freq;
+
+	/*
+	 * Offset of the children block in the child pool. A sparse block holds
+	 * the sorted key bytes followed by the child indices, a FULL block holds
+	 * one child index (or TRIE_NIL) for every letter.
+	 */
+	u32 children;
+	u16 n_children;
+
+	/* Length of the shortest word of the subtree, below the node */
+	u16 short_len;
+
+	/*
+	 * Lengths of the words of the subtree, below the node: bit i is set if a
+	 * word ends i levels lower. The last bit stands for all the longer words.
+	 */
+	u32 len_mask;
+
+	/* Number of distinct words of the subtree, the node's own included */
+	u32 nwords;
+
+	u8 kind;
+
+	/*
+	 * Summaries of the subtree: the letter to follow (or TRIE_SELF/TRIE_NONE)
+	 * to reach its lexicographically smallest, shortest and most frequent
+	 * word. Ties are broken in lexicographic order.
+	 */
+	u8 lex_dir;
+	u8 short_dir;
+	u8 freq_dir;
+};
+
+/*
+ * Entry of the best-first search of AUTOCOMPLETE TOP: either a whole subtree,
+ * ranked by its most frequent word, or a single word. The letters of the
+ * entry are kept in a shared character pool.
+ */
+typedef struct top_entry_t top_entry_t;
+struct top_entry_t {
+	u32 node;
+	int freq;
+	int is_word;
+
+	/* Position and length of the letters of the entry in the pool */
+	int offset;
+	int len;
+};
+
+/*
+ * Resumable walk over the words that start with a prefix, in lexicographic
+ * order, driven by an explicit stack of the nodes of the current path (see
+ * trie_cursor_next). A change of the trie invalidates it.
+ */
+typedef struct trie_cursor_t trie_cursor_t;
+struct trie_cursor_t {
+	struct trie_t *trie;
+
+	/*
+	 * Nodes of the path, from the node of the prefix down, with the next
+	 * letter to try at every one of them: -1 until the node's own word was
+	 * visited. The cursor is done when depth is -1.
+	 */
+	u32 path[MAX_STRING_SIZE];
+	int next[MAX_STRING_SIZE];
+	int depth;
+
+	/* The letters of the path, the prefix included */
+	char word[MAX_STRING_SIZE];
+	int len;
 };
 
 typedef struct trie_t trie_t;
 struct trie_t {
-	trie_node_t *root;
+	/* Arena index of the root node */
+	u32 root;
+
+	/* Node arena, every node is addressed by its 32-bit index */
+	trie_node_t *nodes;
+	/* Number of arena slots handed out so far and the arena capacity */
+	u32 nodes_used;
+	u32 nodes_cap;
+	/* Removed nodes waiting to be reused, chained through children */
+	u32 free_list;
+
+	/* Pool of 32-bit slots that stores the children blocks of the nodes */
+	u32 *kids;
+	u32 kids_used;
+	u32 kids_cap;
+	/* Released children blocks of every kind, chained through slot 0 */
+	u32 kids_free[TRIE_NODE_KINDS];
 
 	/* Number of keys */
 	int size;
 
-	/* Trie-Specific, alphabet properties */
+	/* Number of distinct keys */
+	int nwords;
+
+	/*
+	 * Trie-Specific, alphabet properties. The symbols are kept sorted, so the
+	 * order of the letters (their dense indices) is the order of the bytes.
+	 */
 	int alphabet_size;
-	char *alphabet;
+	char alphabet[TRIE_MAX_ALPHABET + 1];
+
+	/*
+	 * Tokenizer table: for every byte, 1 + the index of the letter it folds
+	 * to, or 0 for a separator. The other case of a letter folds to it, if
+	 * it is not a symbol of the alphabet itself.
+	 */
+	u8 fold[256];
 
 	/* Optional - number of nodes, useful to test correctness */
 	int nnodes;
+
+	/*
+	 * Nodes without any word below them, left by REMOVE until the trie is
+	 * compacted (see trie_compact), and the percentage of the nodes they
+	 * may reach before REMOVE compacts it, 0 if it never does
+	 */
+	int dead_nodes;
+	int compact_percent;
+
+	/* Delete-variant index used by AUTOCORRECT, NULL when it is disabled */
+	symspell_t *symspell;
+
+	/*
+	 * Words by length, scanned by AUTOCORRECT from a tolerance of
+	 * scan_distance on (-1 if never), NULL until the first such query
+	 */
+	wordstore_t *wordstore;
+	int scan_distance;
+
+	/* Number of threads that count the words of a LOAD */
+	int load_threads;
+
+	/*
+	 * Frozen mode (FREEZE): the nodes form a minimized DAWG, see dawg.c, and
+	 * end_of_word is only a flag. The frequencies are kept by the rank of
+	 * the word in lexicographic order, with a segment tree of the most
+	 * frequent rank of every range.
+	 */
+	int frozen;
+	int *freqs;
+	u32 *freq_max;
+
+	/*
+	 * Snapshot opened with OPEN, see snapshot.c: the arenas and the frequency
+	 * tables point into this read-only mapping, NULL if they are allocated.
+	 */
+	void *image;
+	size_t image_size;
+
+	/* Double array of the prefix searches (SET backend datrie), or NULL */
+	struct datrie_t *datrie;
+
+	/* Buffer that collects the output of the queries, NULL for stdout */
+	io_buffer_t *out;
+
+	/* Concurrent mode, with lock-free reader threads, see concurrent.c */
+	struct concurrent_t *concurrent;
+
+	/* Results of the recent queries, see cache.c, or NULL */
+	struct cache_t *cache;
+
+#ifdef TRIE_STATS
+	/* Counters of STATS, see stats.h */
+	trie_stats_t stats;
+#endif
 };
 
 int which_command(char *command);
 
-trie_node_t *trie_create_node(void);
+u32 trie_create_node(trie_t *trie);
+void trie_free_node(trie_t *trie, u32 node);
+void trie_free_block(trie_t *trie, u32 block, int kind);
+u32 trie_child(trie_t *trie, u32 node, int letter);
+void trie_set_child(trie_t *trie, u32 node, int letter, u32 child);
+int trie_next_child(trie_t *trie, u32 node, int letter, u32 *child);
+int trie_children(trie_t *trie, u32 node, u8 *letters,
+				  u32 *children);
+int trie_update_summary(trie_t *trie, u32 node);
+u32 trie_find_prefix(trie_t *trie, char *prefix);
 trie_t *trie_create(int alphabet_size, char *alphabet);
+int trie_set_alphabet(trie_t *trie, const char *alphabet, int alphabet_size);
 void trie_insert(trie_t *trie, char *key);
+void trie_insert_token(trie_t *trie, const char *token, int len, int count);
 void *trie_search(trie_t *trie, char *key);
-void trie_remove_helper(trie_t *trie, trie_node_t *node, char *key, int index);
 void trie_remove(trie_t *trie, char *key);
-void trie_helper_free(trie_node_t *node);
+int trie_compact(trie_t *trie);
 void trie_free(trie_t **ptrie);
+void trie_release_arenas(trie_t *trie);
+void trie_take_arenas(trie_t *trie, trie_t *other);
+void trie_make_writable(trie_t *trie);
+size_t trie_memory_usage(trie_t *trie);
+void trie_memory_report(trie_t *trie);
+int trie_set_option(trie_t *trie, char *option, char *value);
 void trie_load(trie_t *trie, char *filename);
+void trie_load_freq(trie_t *trie, char *filename);
 void trie_autocorrect(trie_t *trie, char *word, int k);
+void trie_autocorrect_edit(trie_t *trie, char *word, int k);
 void trie_autocomplete(trie_t *trie, char *prefix, int k);
+void trie_autocomplete_fuzzy(trie_t *trie, char *prefix, int task, int k);
+void trie_autocomplete_batch(trie_t *trie, char **prefixes, int *tasks, int n);
+void trie_autocomplete_top(trie_t *trie, char *prefix, int n);
+void trie_cursor_init(trie_cursor_t *cursor, trie_t *trie, char *prefix);
+void trie_cursor_skip(trie_cursor_t *cursor, u32 n);
+int trie_cursor_next(trie_cursor_t *cursor);
+void trie_autocomplete_page(trie_t *trie, char *prefix, int offset,
+							int limit);
+
+int trie_has_length(trie_node_t *node, int len);
 
-void DFS_autocorrect(trie_node_t *node, char *word, int k, char *trie_word,
-					 int level, int *ok);
+void DFS_autocorrect(trie_t *trie, u32 node, u8 *word, int len,
+					 int k, char *trie_word, int level, int mismatches,
+					 int *ok);
+void DFS_levenshtein(trie_t *trie, u32 node, u8 *word, int len,
+					 int k, int *rows, char *trie_word, int level, int *ok);
 
 #endif /* TRIE_H_ */
@@ -0,0 +1,24 @@
+/* <Copyright Niculici Mihai-Daniel 2023 > */
+
+#ifndef TYPES_H_
+#define TYPES_H_
+
+#include <stdint.h>
+
+/*
+ * The integers of a fixed width, under the short names of the coding style.
+ * They are the plain types of that width on the targets of mk (ILP32 and
+ * LP64), which the checks below make sure of at compile time.
+ */
+typedef unsigned char u8;
+typedef unsigned short u16;
+typedef unsigned int u32;
+typedef unsigned long long u64;
+typedef signed char s8;
+typedef int s32;
+
+typedef char types_check_u16[sizeof(u16) == 2 ? 1 : -1];
+typedef char types_check_u32[sizeof(u32) == 4 ? 1 : -1];
+typedef char types_check_u64[sizeof(u64) == 8 ? 1 : -1];
+
+#endif /* TYPES_H_ */
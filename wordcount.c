@@ -0,0 +1,207 @@
+/* <Copyright Niculici Mihai-Daniel 2023 > */
+
+#include <pthread.h>
+#include "wordcount.h"
+
+/******************************************************************************
+ * This function computes the hash of a word, after folding its letters, so
+ * that "The" and "the" have the same hash.
+ *
+ * @param fold - The tokenizer table.
+ * @param word - The letters of the word.
+ * @param len - The length of the word.
+ *
+ * @return hash - The 64-bit FNV-1a hash of the folded word.
+ *****************************************************************************/
+static u64 wordcount_hash(const u8 *fold, const char *word, int len)
+{
+	u64 hash = 14695981039346656037ULL;
+
+	for (int i = 0; i < len; i++)
+		hash = (hash ^ fold[(unsigned char)word[i]]) * 1099511628211ULL;
+
+	return hash;
+}
+
+/******************************************************************************
+ * This function checks if two words are the same after folding their letters.
+ *
+ * @param fold - The tokenizer table.
+ * @param a - The letters of the first word.
+ * @param b - The letters of the second word.
+ * @param len - The length of both words.
+ *
+ * @return result - 1 if the words are the same, 0 otherwise.
+ *****************************************************************************/
+static int wordcount_equal(const u8 *fold, const char *a, const char *b,
+						   int len)
+{
+	for (int i = 0; i < len; i++)
+		if (fold[(unsigned char)a[i]] != fold[(unsigned char)b[i]])
+			return 0;
+	return 1;
+}
+
+/******************************************************************************
+ * This function doubles the hash table of a thread.
+ *
+ * @param table - A pointer to the table.
+ *****************************************************************************/
+static void wordcount_grow(wordcount_t *table)
+{
+	wordcount_entry_t *old = table->slots;
+	u32 nold = table->nslots;
+
+	table->nslots *= 2;
+	table->slots = calloc(table->nslots, sizeof(wordcount_entry_t));
+	DIE(!table->slots, "Failed to grow the word count table");
+
+	for (u32 i = 0; i < nold; i++) {
+		if (!old[i].word)
+			continue;
+
+		u32 j = old[i].hash & (table->nslots - 1);
+
+		while (table->slots[j].word)
+			j = (j + 1) & (table->nslots - 1);
+		table->slots[j] = old[i];
+	}
+
+	free(old);
+}
+
+/******************************************************************************
+ * This function counts one more occurrence of a word.
+ *
+ * @param table - A pointer to the table.
+ * @param word - The letters of the word, in the mapped file.
+ * @param len - The length of the word.
+ *****************************************************************************/
+static void wordcount_add(wordcount_t *table, const char *word, int len)
+{
+	u64 hash = wordcount_hash(table->fold, word, len);
+	u32 i = hash & (table->nslots - 1);
+
+	// Linear probing until the word or an empty slot is found
+	while (table->slots[i].word) {
+		wordcount_entry_t *entry = &table->slots[i];
+
+		if (entry->hash == hash && entry->len == (u32)len &&
+			wordcount_equal(table->fold, entry->word, word, len)) {
+			entry->count++;
+			return;
+		}
+		i = (i + 1) & (table->nslots - 1);
+	}
+
+	table->slots[i] = (wordcount_entry_t){word, len, 1, hash};
+
+	// Keep the table at most half full
+	if (2 * ++table->used > table->nslots)
+		wordcount_grow(table);
+}
+
+/******************************************************************************
+ * This function is run by every counting thread: it splits its part of the
+ * file into words, with the tokenizer table, and counts them.
+ *
+ * @param arg - A pointer to the table of the thread.
+ *
+ * @return NULL
+ *****************************************************************************/
+static void *wordcount_run(void *arg)
+{
+	wordcount_t *table = arg;
+	const char *p = table->start, *end = table->end;
+
+	while (p < end) {
+		// Skip the separators
+		while (p < end && !table->fold[(unsigned char)*p])
+			p++;
+
+		// The word goes on until the next separator
+		const char *start = p;
+
+		while (p < end && table->fold[(unsigned char)*p])
+			p++;
+
+		if (p > start && p - start <= table->max_len)
+			wordcount_add(table, start, p - start);
+	}
+
+	return NULL;
+}
+
+/******************************************************************************
+ * This function counts the words of a mapped file with several threads. The
+ * file is cut into one part per thread, and every cut is moved forward to a
+ * separator so that no word is split between two threads.
+ *
+ * @param map - The mapped file.
+ * @param size - The size of the file.
+ * @param fold - The tokenizer table of the trie.
+ * @param max_len - The longest word that is counted.
+ * @param nthreads - The number of threads, at most WORDCOUNT_MAX_THREADS.
+ * @param tables - Vector of nthreads tables, filled with the counts of every
+ *                 thread. They have to be freed with wordcount_free.
+ *
+ * @return n - The number of tables filled, fewer than nthreads if the file is
+ *             too small to give every thread WORDCOUNT_MIN_CHUNK bytes.
+ *****************************************************************************/
+int wordcount_scan(const char *map, size_t size, const u8 *fold,
+				   int max_len, int nthreads, wordcount_t *tables)
+{
+	pthread_t threads[WORDCOUNT_MAX_THREADS];
+	const char *cut = map, *end = map + size;
+	int n = 0;
+
+	if ((size_t)nthreads * WORDCOUNT_MIN_CHUNK > size)
+		nthreads = size / WORDCOUNT_MIN_CHUNK;
+	if (nthreads < 1)
+		nthreads = 1;
+
+	while (n < nthreads && cut < end) {
+		wordcount_t *table = &tables[n];
+		const char *next = n == nthreads - 1 ? end :
+						   map + size / nthreads * (n + 1);
+
+		// Move the cut after the word it falls into
+		if (next < cut)
+			next = cut;
+		while (next < end && fold[(unsigned char)*next])
+			next++;
+
+		table->nslots = WORDCOUNT_INITIAL_SLOTS;
+		table->used = 0;
+		table->slots = calloc(table->nslots, sizeof(wordcount_entry_t));
+		DIE(!table->slots, "Failed to allocate the word count table");
+		table->fold = fold;
+		table->start = cut;
+		table->end = next;
+		table->max_len = max_len;
+
+		cut = next;
+		n++;
+	}
+
+	// The first part is counted by the calling thread
+	for (int i = 1; i < n; i++)
+		DIE(pthread_create(&threads[i], NULL, wordcount_run, &tables[i]),
+			"Failed to start a counting thread");
+	wordcount_run(&tables[0]);
+	for (int i = 1; i < n; i++)
+		pthread_join(threads[i], NULL);
+
+	return n;
+}
+
+/******************************************************************************
+ * This function frees the memory allocated by the table of a thread.
+ *
+ * @param table - A pointer to the table.
+ *****************************************************************************/
+void wordcount_free(wordcount_t *table)
+{
+	free(table->slots);
+	table->slots = NULL;
+}
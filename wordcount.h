@@ -0,0 +1,67 @@
+/* <Copyright Niculici Mihai-Daniel 2023 > */
+
+#ifndef WORDCOUNT_H_
+#define WORDCOUNT_H_
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include "types.h"
+
+#ifndef DIE
+#define DIE(assertion, call_description)				\
+	do {								\
+		if (assertion) {					\
+			fprintf(stderr, "(%s, %d): ",			\
+					__FILE__, __LINE__);		\
+			perror(call_description);			\
+			exit(errno);				        \
+		}							\
+	} while (0)
+#endif
+
+/* Number of slots of the hash table of a counting thread, at the start */
+#define WORDCOUNT_INITIAL_SLOTS 8192
+
+/* Most threads that a LOAD may use */
+#define WORDCOUNT_MAX_THREADS 64
+
+/* Smallest part of a file given to a thread, in bytes */
+#define WORDCOUNT_MIN_CHUNK 65536
+
+/*
+ * A word of a file and its number of occurrences. The word is not copied,
+ * it points into the mapped file, so its letters are not folded yet.
+ */
+typedef struct wordcount_entry_t wordcount_entry_t;
+struct wordcount_entry_t {
+	const char *word;
+	u32 len;
+	u32 count;
+	u64 hash;
+};
+
+/* Open addressing hash table of the words counted by one thread */
+typedef struct wordcount_t wordcount_t;
+struct wordcount_t {
+	wordcount_entry_t *slots;
+	u32 nslots;
+	u32 used;
+
+	/* Tokenizer table of the trie, see trie_t */
+	const u8 *fold;
+
+	/* The part of the file counted by the thread */
+	const char *start;
+	const char *end;
+
+	/* Longest word that is counted, the longer ones are skipped */
+	int max_len;
+};
+
+int wordcount_scan(const char *map, size_t size, const u8 *fold,
+				   int max_len, int nthreads, wordcount_t *tables);
+void wordcount_free(wordcount_t *table);
+
+#endif /* WORDCOUNT_H_ */
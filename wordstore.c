@@ -0,0 +1,473 @@
+/* <Copyright Niculici Mihai-Daniel 2023 > */
+
+#include "wordstore.h"
+
+// The AVX2 kernel is built for x86-64, the SSE2 one wherever SSE2 is on
+#if defined(__GNUC__) && defined(__x86_64__)
+#define WORDSTORE_X86 1
+#endif
+#if defined(WORDSTORE_X86) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+/*
+ * A kernel prints the words of a bucket that differ from the query in at
+ * most k positions, in the order of the bucket, and returns their number.
+ * The vector kernels compare 16 or 32 letters at once: the bytes that are
+ * equal give a mask, and the mismatches are the zeros of the mask within
+ * the word, counted with a popcount.
+ */
+typedef int (*wordstore_kernel_t)(const char *words, u32 n, int len,
+								  const char *query, int k, io_buffer_t *out);
+
+/******************************************************************************
+ * This function is the kernel that compares the words letter by letter, for
+ * the machines without vector instructions.
+ *
+ * @param words - The words of the bucket.
+ * @param n - The number of words.
+ * @param len - The length of the words.
+ * @param query - The query word.
+ * @param k - The maximum number of differences.
+ * @param out - The buffer of the output.
+ *
+ * @return found - The number of words printed.
+ *****************************************************************************/
+static int wordstore_scan_scalar(const char *words, u32 n, int len,
+								 const char *query, int k, io_buffer_t *out)
+{
+	int found = 0;
+
+	for (u32 i = 0; i < n; i++) {
+		const char *word = words + (size_t)i * len;
+		int mismatches = 0;
+
+		for (int j = 0; j < len && mismatches <= k; j++)
+			mismatches += word[j] != query[j];
+		if (mismatches <= k) {
+			io_write_line(out, word, len);
+			found++;
+		}
+	}
+
+	return found;
+}
+
+#ifdef __SSE2__
+/******************************************************************************
+ * This function counts the bits of a 16-bit mask. SSE2 does not come with a
+ * popcount instruction, and __builtin_popcount would be a call without it.
+ *
+ * @param mask - The mask.
+ *
+ * @return count - The number of bits set.
+ *****************************************************************************/
+static inline int wordstore_popcount16(unsigned int mask)
+{
+	mask -= (mask >> 1) & 0x5555;
+	mask = (mask & 0x3333) + ((mask >> 2) & 0x3333);
+	mask = (mask + (mask >> 4)) & 0x0F0F;
+	return (mask + (mask >> 8)) & 0x1F;
+}
+
+/******************************************************************************
+ * This function is the kernel that compares 16 letters at once, with SSE2.
+ * The parameters are the ones of wordstore_scan_scalar.
+ *****************************************************************************/
+static int wordstore_scan_sse2(const char *words, u32 n, int len,
+							   const char *query, int k, io_buffer_t *out)
+{
+	int found = 0;
+
+	for (u32 i = 0; i < n; i++) {
+		const char *word = words + (size_t)i * len;
+		int mismatches = 0;
+
+		for (int j = 0; j < len && mismatches <= k; j += 16) {
+			__m128i a = _mm_loadu_si128((const __m128i *)(word + j));
+			__m128i b = _mm_loadu_si128((const __m128i *)(query + j));
+			unsigned int equal = _mm_movemask_epi8(_mm_cmpeq_epi8(a, b));
+			unsigned int valid = len - j >= 16 ? 0xFFFFu :
+								 (1u << (len - j)) - 1;
+
+			mismatches += wordstore_popcount16(~equal & valid);
+		}
+		if (mismatches <= k) {
+			io_write_line(out, word, len);
+			found++;
+		}
+	}
+
+	return found;
+}
+#endif /* __SSE2__ */
+
+#ifdef WORDSTORE_X86
+/******************************************************************************
+ * This function is the kernel that compares 32 letters at once, with AVX2.
+ * It is compiled for AVX2 (and the popcount instruction, which every AVX2
+ * processor has) on its own, and only used if the processor has it. The
+ * parameters are the ones of wordstore_scan_scalar.
+ *****************************************************************************/
+__attribute__((target("avx2,popcnt")))
+static int wordstore_scan_avx2(const char *words, u32 n, int len,
+							   const char *query, int k, io_buffer_t *out)
+{
+	int found = 0;
+
+	for (u32 i = 0; i < n; i++) {
+		const char *word = words + (size_t)i * len;
+		int mismatches = 0;
+
+		for (int j = 0; j < len && mismatches <= k; j += 32) {
+			__m256i a = _mm256_loadu_si256((const __m256i *)(word + j));
+			__m256i b = _mm256_loadu_si256((const __m256i *)(query + j));
+			unsigned int equal = _mm256_movemask_epi8(_mm256_cmpeq_epi8(a, b));
+			unsigned int valid = len - j >= 32 ? 0xFFFFFFFFu :
+								 (1u << (len - j)) - 1;
+
+			mismatches += __builtin_popcount(~equal & valid);
+		}
+		if (mismatches <= k) {
+			io_write_line(out, word, len);
+			found++;
+		}
+	}
+
+	return found;
+}
+#endif /* WORDSTORE_X86 */
+
+/* The kernels, the best first, up to an empty one, and the one in use */
+static const struct {
+	const char *name;
+	wordstore_kernel_t scan;
+} wordstore_kernels[] = {
+#ifdef WORDSTORE_X86
+	{"avx2", wordstore_scan_avx2},
+#endif
+#ifdef __SSE2__
+	{"sse2", wordstore_scan_sse2},
+#endif
+	{"scalar", wordstore_scan_scalar},
+	{NULL, NULL}
+};
+
+static int wordstore_kernel = -1;
+
+/******************************************************************************
+ * This function tells if the processor runs a kernel.
+ *
+ * @param i - The index of the kernel in wordstore_kernels.
+ *
+ * @return result - 1 if it does, 0 otherwise.
+ *****************************************************************************/
+static int wordstore_kernel_supported(int i)
+{
+#ifdef WORDSTORE_X86
+	if (wordstore_kernels[i].scan == wordstore_scan_avx2)
+		return __builtin_cpu_supports("avx2");
+#endif
+	(void)i;
+	return 1;
+}
+
+/******************************************************************************
+ * This function chooses the kernel of the scans (SET simd <kernel>).
+ *
+ * @param name - The name of the kernel: "avx2", "sse2" or "scalar".
+ *
+ * @return result - 0 if the kernel is used from now on, -1 if it is not
+ *                  compiled in or the processor does not run it.
+ *****************************************************************************/
+int wordstore_set_kernel(const char *name)
+{
+	for (int i = 0; wordstore_kernels[i].name; i++) {
+		if (strcmp(wordstore_kernels[i].name, name) != 0)
+			continue;
+		if (!wordstore_kernel_supported(i))
+			return -1;
+		wordstore_kernel = i;
+		return 0;
+	}
+
+	return -1;
+}
+
+/******************************************************************************
+ * This function returns the name of the kernel of the scans, choosing the
+ * best one the processor runs if none was chosen.
+ *
+ * @return name - The name of the kernel.
+ *****************************************************************************/
+const char *wordstore_kernel_name(void)
+{
+	if (wordstore_kernel < 0) {
+		wordstore_kernel = 0;
+		while (!wordstore_kernel_supported(wordstore_kernel))
+			wordstore_kernel++;
+	}
+
+	return wordstore_kernels[wordstore_kernel].name;
+}
+
+/******************************************************************************
+ * This function creates an empty word store.
+ *
+ * @return store - A pointer to the store.
+ *****************************************************************************/
+wordstore_t *wordstore_create(void)
+{
+	wordstore_t *store = calloc(1, sizeof(wordstore_t));
+	DIE(!store, "Failed to allocate memory for the word store");
+
+	// The scans use the best kernel, unless one was chosen
+	wordstore_kernel_name();
+
+	return store;
+}
+
+/******************************************************************************
+ * This function adds a word to the store. It goes at the end of its bucket,
+ * to be sorted by the next scan of the bucket.
+ *
+ * @param store - A pointer to the store.
+ * @param word - The word, not in the store.
+ * @param len - The length of the word.
+ *****************************************************************************/
+void wordstore_add(wordstore_t *store, const char *word, int len)
+{
+	if (len <= 0)
+		return;
+
+	// The buckets go up to the longest word, the query buffer with them
+	if (len >= store->nbuckets) {
+		int n = len + 1;
+
+		store->buckets = realloc(store->buckets,
+								 n * sizeof(wordstore_bucket_t));
+		DIE(!store->buckets, "Failed to grow the buckets of the word store");
+		memset(store->buckets + store->nbuckets, 0,
+			   (n - store->nbuckets) * sizeof(wordstore_bucket_t));
+		store->nbuckets = n;
+
+		free(store->query);
+		store->query = calloc(n + WORDSTORE_PAD, 1);
+		DIE(!store->query, "Failed to allocate the query of the word store");
+	}
+
+	wordstore_bucket_t *bucket = &store->buckets[len];
+
+	if (bucket->n == bucket->cap) {
+		bucket->cap = bucket->cap ? 2 * bucket->cap : WORDSTORE_INITIAL_WORDS;
+		bucket->words = realloc(bucket->words,
+								(size_t)bucket->cap * len + WORDSTORE_PAD);
+		DIE(!bucket->words, "Failed to grow a bucket of the word store");
+
+		// The loads of the last words read the bytes after them
+		memset(bucket->words + (size_t)bucket->n * len, 0,
+			   (size_t)(bucket->cap - bucket->n) * len + WORDSTORE_PAD);
+	}
+
+	memcpy(bucket->words + (size_t)bucket->n * len, word, len);
+
+	// A word after the last sorted one keeps the bucket sorted
+	if (bucket->nsorted == bucket->n &&
+		(bucket->n == 0 || memcmp(bucket->words +
+								  (size_t)(bucket->n - 1) * len,
+								  word, len) < 0))
+		bucket->nsorted++;
+	bucket->n++;
+	store->nwords++;
+}
+
+/******************************************************************************
+ * This function removes a word from the store. The words after it move back,
+ * so the sorted ones stay sorted.
+ *
+ * @param store - A pointer to the store.
+ * @param word - The word.
+ * @param len - The length of the word.
+ *****************************************************************************/
+void wordstore_remove(wordstore_t *store, const char *word, int len)
+{
+	if (len <= 0 || len >= store->nbuckets)
+		return;
+
+	wordstore_bucket_t *bucket = &store->buckets[len];
+	u32 lo = 0, hi = bucket->nsorted, i;
+
+	// Binary search in the sorted words, then a scan of the others
+	while (lo < hi) {
+		u32 mid = lo + (hi - lo) / 2;
+
+		if (memcmp(bucket->words + (size_t)mid * len, word, len) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	i = lo;
+	if (i == bucket->nsorted ||
+		memcmp(bucket->words + (size_t)i * len, word, len) != 0)
+		for (i = bucket->nsorted; i < bucket->n; i++)
+			if (memcmp(bucket->words + (size_t)i * len, word, len) == 0)
+				break;
+	if (i == bucket->n)
+		return;
+
+	memmove(bucket->words + (size_t)i * len,
+			bucket->words + (size_t)(i + 1) * len,
+			(size_t)(bucket->n - i - 1) * len);
+	if (i < bucket->nsorted)
+		bucket->nsorted--;
+	bucket->n--;
+	store->nwords--;
+}
+
+/******************************************************************************
+ * This function merges two sorted runs of words of the same length.
+ *
+ * @param a - The first run.
+ * @param na - The number of words of the first run.
+ * @param b - The second run.
+ * @param nb - The number of words of the second run.
+ * @param len - The length of the words.
+ * @param out - Buffer of (na + nb) * len bytes for the merged words.
+ *****************************************************************************/
+static void wordstore_merge(const char *a, u32 na, const char *b,
+							u32 nb, int len, char *out)
+{
+	while (na > 0 && nb > 0) {
+		if (memcmp(a, b, len) <= 0) {
+			memcpy(out, a, len);
+			a += len;
+			na--;
+		} else {
+			memcpy(out, b, len);
+			b += len;
+			nb--;
+		}
+		out += len;
+	}
+	memcpy(out, a, (size_t)na * len);
+	memcpy(out + (size_t)na * len, b, (size_t)nb * len);
+}
+
+/******************************************************************************
+ * This function sorts words of the same length, with a merge sort.
+ *
+ * @param words - The words.
+ * @param n - The number of words.
+ * @param len - The length of the words.
+ * @param tmp - Buffer of n * len bytes.
+ *****************************************************************************/
+static void wordstore_sort(char *words, u32 n, int len, char *tmp)
+{
+	u32 half = n / 2;
+
+	if (n < 2)
+		return;
+
+	wordstore_sort(words, half, len, tmp);
+	wordstore_sort(words + (size_t)half * len, n - half, len, tmp);
+	wordstore_merge(words, half, words + (size_t)half * len, n - half, len,
+					tmp);
+	memcpy(words, tmp, (size_t)n * len);
+}
+
+/******************************************************************************
+ * This function sorts the words added to a bucket since its last scan and
+ * merges them with the sorted ones.
+ *
+ * @param bucket - A pointer to the bucket.
+ * @param len - The length of its words.
+ *****************************************************************************/
+static void wordstore_settle(wordstore_bucket_t *bucket, int len)
+{
+	char *added = bucket->words + (size_t)bucket->nsorted * len;
+	u32 nadded = bucket->n - bucket->nsorted;
+
+	if (nadded == 0)
+		return;
+
+	char *tmp = malloc((size_t)bucket->n * len);
+	DIE(!tmp, "Failed to allocate memory to sort the word store");
+
+	wordstore_sort(added, nadded, len, tmp);
+	wordstore_merge(bucket->words, bucket->nsorted, added, nadded, len, tmp);
+	memcpy(bucket->words, tmp, (size_t)bucket->n * len);
+	bucket->nsorted = bucket->n;
+
+	free(tmp);
+}
+
+/******************************************************************************
+ * This function prints the words of the store that differ from a word in at
+ * most k positions, in lexicographic order, like the DFS of AUTOCORRECT.
+ * Only the bucket of the length of the word is scanned.
+ *
+ * @param store - A pointer to the store.
+ * @param word - The word, folded like the words of the store.
+ * @param len - The length of the word.
+ * @param k - The maximum number of differences.
+ * @param out - The buffer of the output, or NULL for stdout.
+ *
+ * @return found - The number of words printed.
+ *****************************************************************************/
+int wordstore_autocorrect(wordstore_t *store, const char *word, int len,
+						  int k, io_buffer_t *out)
+{
+	if (k < 0 || len <= 0 || len >= store->nbuckets ||
+		store->buckets[len].n == 0)
+		return 0;
+
+	wordstore_bucket_t *bucket = &store->buckets[len];
+
+	wordstore_settle(bucket, len);
+
+	// The loads of the query read up to WORDSTORE_PAD bytes after it
+	memcpy(store->query, word, len);
+	memset(store->query + len, 0, WORDSTORE_PAD);
+
+	return wordstore_kernels[wordstore_kernel].scan(bucket->words, bucket->n,
+													len, store->query, k,
+													out);
+}
+
+/******************************************************************************
+ * This function computes the memory used by the store.
+ *
+ * @param store - A pointer to the store.
+ *
+ * @return bytes - The number of bytes allocated for the store.
+ *****************************************************************************/
+size_t wordstore_memory_usage(wordstore_t *store)
+{
+	size_t bytes = sizeof(wordstore_t) +
+				   store->nbuckets * sizeof(wordstore_bucket_t);
+
+	if (store->query)
+		bytes += store->nbuckets + WORDSTORE_PAD;
+	for (int len = 1; len < store->nbuckets; len++)
+		if (store->buckets[len].words)
+			bytes += (size_t)store->buckets[len].cap * len + WORDSTORE_PAD;
+
+	return bytes;
+}
+
+/******************************************************************************
+ * This function frees the memory allocated by the store.
+ *
+ * @param pstore - A double pointer to the store.
+ *****************************************************************************/
+void wordstore_free(wordstore_t **pstore)
+{
+	wordstore_t *store = *pstore;
+
+	for (int len = 0; len < store->nbuckets; len++)
+		free(store->buckets[len].words);
+	free(store->buckets);
+	free(store->query);
+	free(store);
+	*pstore = NULL;
+}
@@ -0,0 +1,77 @@
+/* <Copyright Niculici Mihai-Daniel 2023 > */
+
+#ifndef WORDSTORE_H_
+#define WORDSTORE_H_
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include "types.h"
+#include "io.h"
+
+#ifndef DIE
+#define DIE(assertion, call_description)				\
+	do {								\
+		if (assertion) {					\
+			fprintf(stderr, "(%s, %d): ",			\
+					__FILE__, __LINE__);		\
+			perror(call_description);			\
+			exit(errno);				        \
+		}							\
+	} while (0)
+#endif
+
+/*
+ * Smallest tolerance of AUTOCORRECT answered by the scan of the word store,
+ * by default (SET scan <k> changes it). The DFS of the trie abandons a
+ * branch after k mismatches, so it wins for the small tolerances.
+ */
+#define WORDSTORE_MIN_DISTANCE 2
+
+/* Bytes readable after the last word of a bucket, for the vector loads */
+#define WORDSTORE_PAD 32
+
+/* Number of words a bucket has room for when it is created */
+#define WORDSTORE_INITIAL_WORDS 16
+
+/*
+ * The words of one length, side by side without terminators, so the word i
+ * starts at byte i * len. The first nsorted words are in lexicographic
+ * order, the ones after them were added since the last scan.
+ */
+typedef struct wordstore_bucket_t wordstore_bucket_t;
+struct wordstore_bucket_t {
+	char *words;
+	u32 n;
+	u32 nsorted;
+	u32 cap;
+};
+
+/*
+ * Flat copy of the words of the trie, grouped by length, for the AUTOCORRECT
+ * by Hamming distance: it only compares words of the same length, so a
+ * query is a scan of one contiguous bucket, a few vector compares per word.
+ */
+typedef struct wordstore_t wordstore_t;
+struct wordstore_t {
+	/* The buckets, by length, and the longest length plus one */
+	wordstore_bucket_t *buckets;
+	int nbuckets;
+	u32 nwords;
+
+	/* The query, followed by WORDSTORE_PAD zero bytes */
+	char *query;
+};
+
+wordstore_t *wordstore_create(void);
+int wordstore_set_kernel(const char *name);
+const char *wordstore_kernel_name(void);
+void wordstore_add(wordstore_t *store, const char *word, int len);
+void wordstore_remove(wordstore_t *store, const char *word, int len);
+int wordstore_autocorrect(wordstore_t *store, const char *word, int len,
+						  int k, io_buffer_t *out);
+size_t wordstore_memory_usage(wordstore_t *store);
+void wordstore_free(wordstore_t **pstore);
+
+#endif /* WORDSTORE_H_ */